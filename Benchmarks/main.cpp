@@ -0,0 +1,442 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include <QtCore>
+#include <QDebug>
+#include <functional>
+#include <QAlgorithm.h>
+#include <QAGraphExecutor.h>
+#include <QAGraphSnapshot.h>
+#include <QANodeArena.h>
+
+// Trivial algorithm used to build the graphs: it outputs its depth in the graph
+class Node: public QAlgorithm
+{
+	Q_OBJECT
+
+	QA_INPUT_LIST(int, Value)
+	QA_OUTPUT(int, Value)
+
+	QA_IMPL_CREATE(Node)
+	QA_CTOR_INHERIT
+
+public:
+	void run();
+};
+
+// Trivial algorithm with a single input, used by the micro-benchmarks
+class Scalar: public QAlgorithm
+{
+	Q_OBJECT
+
+	QA_INPUT(int, Value)
+	QA_PARAMETER(int, Offset, 0)
+	QA_OUTPUT(int, Value)
+
+	QA_IMPL_CREATE(Scalar)
+	QA_CTOR_INHERIT
+
+public:
+	void run();
+	QAShrAlgorithm sharedThis() const
+	{
+		return findSharedThis();
+	}
+};
+
+void Node::run()
+{
+	int depth = 0;
+	for(int value: getInRefValue()) depth = qMax(depth, value);
+	setOutValue(depth + 1);
+}
+
+void Scalar::run()
+{
+	setOutValue(getInValue() + getOffset());
+}
+
+namespace
+{
+	struct Result
+	{
+		QString name;
+		qint64 operations;
+		qint64 nsecs;
+	};
+
+	struct Graph
+	{
+		QVector<QAShrAlgorithm> nodes;
+		// Node from which the execution is started
+		QAShrAlgorithm entry;
+	};
+
+	enum class Mode
+	{
+		Parallel,
+		Serial,
+		Executor
+	};
+
+	// Whether the benchmark called name is selected by the filter
+	bool selected(const QString& name, const QString& filter)
+	{
+		return filter.isEmpty() || name.contains(filter);
+	}
+
+	// Run the body several times and keep the fastest repetition
+	Result measure(const QString& name, qint64 operations, int repetitions,
+				   const std::function<void()>& setup, const std::function<void()>& body)
+	{
+		qint64 best = std::numeric_limits<qint64>::max();
+		for(int k = 0; k < repetitions; ++k)
+		{
+			if(setup) setup();
+			QElapsedTimer timer;
+			timer.start();
+			body();
+			best = qMin(best, timer.nsecsElapsed());
+		}
+		return Result{name, operations, best};
+	}
+
+	QVector<QAShrAlgorithm> createNodes(int n)
+	{
+		QVector<QAShrAlgorithm> nodes;
+		nodes.reserve(n);
+		for(int k = 0; k < n; ++k) nodes << Node::create();
+		return nodes;
+	}
+
+	Graph buildChain(int n)
+	{
+		Graph graph;
+		graph.nodes = createNodes(n);
+		for(int k = 1; k < n; ++k) graph.nodes[k-1] >> graph.nodes[k];
+		graph.entry = graph.nodes.first();
+		return graph;
+	}
+
+	Graph buildFanOut(int n)
+	{
+		Graph graph;
+		graph.nodes = createNodes(n);
+		for(int k = 1; k < n; ++k) graph.nodes.first() >> graph.nodes[k];
+		graph.entry = graph.nodes.first();
+		return graph;
+	}
+
+	Graph buildFanIn(int n)
+	{
+		Graph graph;
+		graph.nodes = createNodes(n);
+		for(int k = 0; k < n-1; ++k) graph.nodes[k] >> graph.nodes.last();
+		graph.entry = graph.nodes.last();
+		return graph;
+	}
+
+	Graph buildDiamond(int n)
+	{
+		Graph graph;
+		graph.nodes = createNodes(n);
+		for(int k = 1; k < n-1; ++k) graph.nodes.first() >> graph.nodes[k] >> graph.nodes.last();
+		graph.entry = graph.nodes.last();
+		return graph;
+	}
+
+	Graph buildRandom(int n)
+	{
+		// Each node has one or two parents among the previous nodes
+		QRandomGenerator random(42);
+		Graph graph;
+		graph.nodes = createNodes(n);
+		for(int k = 1; k < n; ++k)
+		{
+			graph.nodes[random.bounded(k)] >> graph.nodes[k];
+			graph.nodes[random.bounded(k)] >> graph.nodes[k];
+		}
+		graph.entry = graph.nodes.first();
+		return graph;
+	}
+
+	// Break the reference cycles between connected nodes, and delete them
+	void teardown(Graph& graph)
+	{
+		for(const auto& node: graph.nodes)
+		{
+			const QAAdjacencyList descendants = node->getDescendantList();
+			for(const auto& descendant: descendants) QAlgorithm::closeConnection(node, descendant);
+		}
+		graph.nodes.clear();
+		graph.entry.clear();
+		QCoreApplication::sendPostedEvents(Q_NULLPTR, QEvent::DeferredDelete);
+	}
+
+	void execute(Graph& graph, Mode mode)
+	{
+		switch(mode)
+		{
+			case Mode::Parallel:
+			{
+				// Wait in an event loop for every node to finish
+				QEventLoop loop;
+				int remaining = graph.nodes.size();
+				for(const auto& node: graph.nodes)
+				{
+					QObject::connect(node.data(), &QAlgorithm::justFinished, &loop, [&remaining, &loop]()
+									 {
+										 if(--remaining == 0) loop.quit();
+									 }, Qt::DirectConnection);
+				}
+				graph.entry->parallelExecution();
+				loop.exec();
+				break;
+			}
+			case Mode::Serial:
+			{
+				// Serial propagation recurses once per level, hence the large stack
+				for(const auto& node: graph.nodes) node->setParallelExecution(false);
+				QAShrAlgorithm entry = graph.entry;
+				QThread* thread = QThread::create([entry]()
+												  {
+													  entry->serialExecution();
+												  });
+				thread->setStackSize(512u * 1024u * 1024u);
+				thread->start();
+				thread->wait();
+				delete thread;
+				break;
+			}
+			case Mode::Executor:
+			{
+				QAGraphExecutor executor(graph.entry);
+				executor.execute();
+				executor.waitForDone();
+				break;
+			}
+		}
+	}
+
+	QVector<Result> microBenchmarks(int n, int repetitions, const QString& filter)
+	{
+		QVector<Result> results;
+		Graph graph;
+
+		if(selected("micro/create", filter)) results << measure("micro/create", n, repetitions, [&graph]()
+						   {
+							   teardown(graph);
+						   }, [&graph, n]()
+						   {
+							   graph.nodes = createNodes(n);
+						   });
+		teardown(graph);
+
+		if(selected("micro/createPooled", filter))
+		{
+			// Recycled instances, released all together by an arena
+			QANodeArena arena;
+			results << measure("micro/createPooled", n, repetitions, [&arena]()
+							   {
+								   arena.release();
+							   }, [&arena, n]()
+							   {
+								   for(int k = 0; k < n; ++k) arena.create<Node>();
+							   });
+		}
+
+		if(selected("micro/setConnection", filter)) results << measure("micro/setConnection", n-1, repetitions, [&graph, n]()
+						   {
+							   teardown(graph);
+							   graph.nodes = createNodes(n);
+						   }, [&graph, n]()
+						   {
+							   for(int k = 1; k < n; ++k) QAlgorithm::setConnection(graph.nodes[k-1], graph.nodes[k]);
+						   });
+		teardown(graph);
+
+		{
+			auto parent = Scalar::create({{"Offset", 1}});
+			auto child = Scalar::create();
+			if(selected("micro/getInput", filter)) results << measure("micro/getInput", n, repetitions, Q_NULLPTR, [parent, child, n]()
+							   {
+								   for(int k = 0; k < n; ++k) child->getInput(parent);
+							   });
+			if(selected("micro/setParameters", filter)) results << measure("micro/setParameters", n, repetitions, Q_NULLPTR, [child, n]()
+							   {
+								   const QAPropertyMap parameters = {{"Offset", 2}, {"Value", 3}};
+								   for(int k = 0; k < n; ++k) child->setParameters(parameters);
+							   });
+			if(selected("micro/setParameterHandle", filter)) results << measure("micro/setParameterHandle", n, repetitions, Q_NULLPTR, [child, n]()
+							   {
+								   const QAParameterHandle offset = child->parameterHandle("Offset");
+								   for(int k = 0; k < n; ++k) child->setParameter(offset, k);
+							   });
+		}
+
+		if(selected("micro/findSharedThis", filter))
+		{
+			// A node in the middle of a fan-in with many neighbours
+			graph.nodes.clear();
+			auto center = Scalar::create();
+			graph.nodes << center;
+			const int degree = qMin(n, 1000);
+			for(int k = 0; k < degree; ++k)
+			{
+				auto neighbour = Node::create();
+				neighbour >> center;
+				graph.nodes << neighbour;
+			}
+			results << measure("micro/findSharedThis", n, repetitions, Q_NULLPTR, [center, n]()
+							   {
+								   for(int k = 0; k < n; ++k) center->sharedThis();
+							   });
+			teardown(graph);
+		}
+
+		if(selected("micro/flattenTree", filter) || selected("micro/snapshot", filter))
+		{
+			graph = buildRandom(n);
+			if(selected("micro/flattenTree", filter)) results << measure("micro/flattenTree", n, repetitions, Q_NULLPTR, [&graph]()
+							   {
+								   graph.entry->flattenTree();
+							   });
+			if(selected("micro/snapshot", filter)) results << measure("micro/snapshot", n, repetitions, Q_NULLPTR, [&graph]()
+							   {
+								   graph.entry->snapshot();
+							   });
+			teardown(graph);
+		}
+
+		if(selected("micro/improveTree", filter))
+		{
+			graph = buildChain(n);
+			results << measure("micro/improveTree", n, repetitions, Q_NULLPTR, [&graph]()
+							   {
+								   QAlgorithm::improveTree(graph.entry.data());
+							   });
+			teardown(graph);
+		}
+
+		return results;
+	}
+
+	QVector<Result> macroBenchmarks(int n, int repetitions, const QString& filter)
+	{
+		const QVector<QPair<QString, std::function<Graph(int)>>> shapes =
+		{
+			{"chain", buildChain},
+			{"fanout", buildFanOut},
+			{"fanin", buildFanIn},
+			{"diamond", buildDiamond},
+			{"random", buildRandom}
+		};
+		const QVector<QPair<QString, Mode>> modes =
+		{
+			{"parallelExecution", Mode::Parallel},
+			{"serialExecution", Mode::Serial},
+			{"QAGraphExecutor", Mode::Executor}
+		};
+		QVector<Result> results;
+		for(const auto& shape: shapes)
+		{
+			for(const auto& mode: modes)
+			{
+				const QString name = "macro/" + shape.first + "/" + mode.first;
+				if(!selected(name, filter)) continue;
+				Graph graph;
+				results << measure(name, n, repetitions, [&graph, &shape, n]()
+								   {
+									   teardown(graph);
+									   graph = shape.second(n);
+								   }, [&graph, &mode]()
+								   {
+									   execute(graph, mode.second);
+								   });
+				teardown(graph);
+			}
+		}
+		return results;
+	}
+
+	QJsonObject toJson(const Result& result)
+	{
+		const double perOperation = result.operations > 0 ? double(result.nsecs) / result.operations : 0.0;
+		const bool macro = result.name.startsWith("macro/");
+		QJsonObject object;
+		object["name"] = result.name;
+		object[macro ? "nodes" : "operations"] = double(result.operations);
+		object["total_ns"] = double(result.nsecs);
+		object[macro ? "ns_per_node" : "ns_per_op"] = perOperation;
+		object[macro ? "nodes_per_sec" : "ops_per_sec"] = perOperation > 0 ? 1e9 / perOperation : 0.0;
+		return object;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("QAlgorithmBench");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the overhead of the QAlgorithm framework");
+	parser.addHelpOption();
+	QCommandLineOption nodesOption("nodes", "Number of nodes of each graph (default 10000).", "n", "10000");
+	QCommandLineOption repetitionsOption("repetitions", "Repetitions of each benchmark, the fastest is kept (default 3).", "r", "3");
+	QCommandLineOption filterOption("filter", "Only run benchmarks whose name contains the given text.", "text");
+	QCommandLineOption outputOption("output", "Write the JSON report to the given file instead of the standard output.", "path");
+	parser.addOptions({nodesOption, repetitionsOption, filterOption, outputOption});
+	parser.process(app);
+
+	const int n = qMax(3, parser.value(nodesOption).toInt());
+	const int repetitions = qMax(1, parser.value(repetitionsOption).toInt());
+	const QString filter = parser.value(filterOption);
+
+	QVector<Result> results;
+	results += microBenchmarks(n, repetitions, filter);
+	results += macroBenchmarks(n, repetitions, filter);
+
+	QJsonArray benchmarks;
+	for(const Result& result: results) benchmarks.append(toJson(result));
+	QJsonObject report;
+	report["qt_version"] = qVersion();
+	report["threads"] = QThreadPool::globalInstance()->maxThreadCount();
+	report["nodes"] = n;
+	report["repetitions"] = repetitions;
+	report["benchmarks"] = benchmarks;
+	const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+	if(parser.isSet(outputOption))
+	{
+		QFile file(parser.value(outputOption));
+		if(!file.open(QFile::WriteOnly))
+		{
+			qCritical() << "Cannot write the report to" << file.fileName();
+			return 1;
+		}
+		file.write(json);
+	}
+	else
+	{
+		QTextStream(stdout) << json;
+	}
+	return 0;
+}
+
+#include "main.moc"
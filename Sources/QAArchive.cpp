@@ -0,0 +1,397 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QAArchive.h"
+#include "QAGraphSnapshot.h"
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+	const quint32 archiveMagic = 0x51414152; // "QAAR"
+	const QDataStream::Version streamVersion = QDataStream::Qt_5_6;
+
+	// Arrays of numbers, written as element count and raw bytes
+	struct RawArrayType
+	{
+		int typeId;
+		void (*save)(QDataStream&, const void*);
+		bool (*load)(QDataStream&, void*);
+	};
+
+	template<typename T>
+	void saveVector(QDataStream& stream, const void* data)
+	{
+		const QVector<T>& array = *static_cast<const QVector<T>*>(data);
+		stream << quint32(array.size());
+		stream.writeRawData(reinterpret_cast<const char*>(array.constData()), int(sizeof(T)) * array.size());
+	}
+
+	// Whether an array of the given size, read from the stream, can be allocated and read
+	bool checkArraySize(QDataStream& stream, quint32 size, size_t elementSize)
+	{
+		const quint64 bytes = quint64(size) * elementSize;
+		const QIODevice* device = stream.device();
+		if(bytes > quint64(INT_MAX) ||
+		   (device != Q_NULLPTR && !device->isSequential() && bytes > quint64(device->bytesAvailable())))
+		{
+			stream.setStatus(QDataStream::ReadCorruptData);
+			return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool loadVector(QDataStream& stream, void* data)
+	{
+		QVector<T>& array = *static_cast<QVector<T>*>(data);
+		quint32 size = 0;
+		stream >> size;
+		if(stream.status() != QDataStream::Ok || !checkArraySize(stream, size, sizeof(T))) return false;
+		array.resize(int(size));
+		const int bytes = int(sizeof(T)) * array.size();
+		return stream.readRawData(reinterpret_cast<char*>(array.data()), bytes) == bytes;
+	}
+
+	void saveBytes(QDataStream& stream, const void* data)
+	{
+		const QByteArray& array = *static_cast<const QByteArray*>(data);
+		stream << quint32(array.size());
+		stream.writeRawData(array.constData(), array.size());
+	}
+
+	bool loadBytes(QDataStream& stream, void* data)
+	{
+		QByteArray& array = *static_cast<QByteArray*>(data);
+		quint32 size = 0;
+		stream >> size;
+		if(stream.status() != QDataStream::Ok || !checkArraySize(stream, size, 1)) return false;
+		array.resize(int(size));
+		return stream.readRawData(array.data(), array.size()) == array.size();
+	}
+
+	template<typename T>
+	RawArrayType vectorType()
+	{
+		return RawArrayType{qMetaTypeId<QVector<T>>(), &saveVector<T>, &loadVector<T>};
+	}
+
+	const RawArrayType* rawArrayType(int typeId)
+	{
+		static const QVector<RawArrayType> types = {
+			RawArrayType{QMetaType::QByteArray, &saveBytes, &loadBytes},
+			vectorType<qint8>(), vectorType<quint8>(), vectorType<qint16>(), vectorType<quint16>(),
+			vectorType<qint32>(), vectorType<quint32>(), vectorType<qint64>(), vectorType<quint64>(),
+			vectorType<float>(), vectorType<double>()
+		};
+		for(const auto& type: types)
+		{
+			if(type.typeId == typeId) return &type;
+		}
+		return Q_NULLPTR;
+	}
+
+	// Properties that make up the state of an algorithm; those of QAlgorithm itself
+	// are execution policies, set up again when the graph is built
+	bool isStateProperty(const QMetaProperty& prop)
+	{
+		if(prop.propertyIndex() < QAlgorithm::staticMetaObject.propertyCount()) return false;
+		for(const char* prefix: {QA_IN, QA_OUT, QA_PAR, QA_PORT_IN, QA_PORT_OUT})
+		{
+			if(qstrncmp(prop.name(), prefix, qstrlen(prefix)) == 0) return true;
+		}
+		return false;
+	}
+}
+
+QAArchive::QAArchive(QIODevice* device) : m_stream(device)
+{
+	m_stream.setVersion(streamVersion);
+}
+
+quint16 QAArchive::formatVersion() const
+{
+	return m_version;
+}
+
+bool QAArchive::writeHeader()
+{
+	if(m_headerWritten) return true;
+	m_headerWritten = true;
+	m_stream << archiveMagic << FormatVersion << quint16(streamVersion) << quint8(QSysInfo::ByteOrder);
+	return m_stream.status() == QDataStream::Ok;
+}
+
+bool QAArchive::readHeader()
+{
+	if(m_headerRead) return m_version != 0;
+	m_headerRead = true;
+	quint32 magic = 0;
+	quint16 version = 0, dataVersion = 0;
+	quint8 byteOrder = 0;
+	m_stream >> magic >> version >> dataVersion >> byteOrder;
+	if(m_stream.status() != QDataStream::Ok || magic != archiveMagic)
+	{
+		qWarning() << "QAArchive: not an archive";
+		return false;
+	}
+	if(version == 0 || version > FormatVersion)
+	{
+		qWarning() << "QAArchive: unsupported format version" << version;
+		return false;
+	}
+	if(byteOrder != quint8(QSysInfo::ByteOrder))
+	{
+		qWarning() << "QAArchive: the archive has been written with a different byte order";
+		return false;
+	}
+	m_stream.setVersion(dataVersion);
+	m_version = version;
+	return true;
+}
+
+quint32 QAArchive::schemaOf(const QMetaObject* metaObject)
+{
+	auto it = m_writtenSchemas.constFind(metaObject);
+	if(it != m_writtenSchemas.constEnd()) return it.value();
+	// First instance of this class: describe its properties
+	QVector<Field> fields;
+	for(int k = 0; k < metaObject->propertyCount(); ++k)
+	{
+		const QMetaProperty prop = metaObject->property(k);
+		if(!isStateProperty(prop)) continue;
+		Field field;
+		field.ordinal = k;
+		field.name = prop.name();
+		field.typeId = prop.userType();
+		field.typeName = QMetaType::typeName(field.typeId);
+		field.encoding = rawArrayType(field.typeId) ? RawArray : Generic;
+		fields << field;
+	}
+	const quint32 id = quint32(m_writtenFields.size());
+	m_stream << quint8(SchemaRecord) << id << QByteArray(metaObject->className()) << quint32(fields.size());
+	for(const Field& field: fields)
+	{
+		m_stream << quint32(field.ordinal) << field.name << field.typeName << quint8(field.encoding);
+	}
+	m_writtenSchemas.insert(metaObject, id);
+	m_writtenFields << fields;
+	return id;
+}
+
+bool QAArchive::readSchema()
+{
+	quint32 id = 0, count = 0;
+	Schema schema;
+	m_stream >> id >> schema.className >> count;
+	if(m_stream.status() != QDataStream::Ok || id != quint32(m_readSchemas.size()))
+	{
+		qWarning() << "QAArchive: corrupted schema record";
+		return false;
+	}
+	schema.fields.reserve(int(count));
+	for(quint32 k = 0; k < count; ++k)
+	{
+		Field field;
+		quint32 ordinal = 0;
+		quint8 encoding = 0;
+		m_stream >> ordinal >> field.name >> field.typeName >> encoding;
+		field.ordinal = int(ordinal);
+		field.encoding = Encoding(encoding);
+		field.typeId = QMetaType::type(field.typeName.constData());
+		if(field.typeId == QMetaType::UnknownType)
+		{
+			qWarning() << "QAArchive: unknown type" << field.typeName << "of" << schema.className << field.name;
+			return false;
+		}
+		if(field.encoding == RawArray && !rawArrayType(field.typeId))
+		{
+			qWarning() << "QAArchive:" << field.typeName << "is not an array of numbers";
+			return false;
+		}
+		schema.fields << field;
+	}
+	m_readSchemas << schema;
+	return m_stream.status() == QDataStream::Ok;
+}
+
+void QAArchive::resolve(Schema& schema, const QMetaObject* metaObject)
+{
+	if(schema.target == metaObject) return;
+	schema.target = metaObject;
+	schema.targetIndices.clear();
+	for(const Field& field: schema.fields)
+	{
+		// Same class, same ordinal: no lookup by name is needed
+		int index = field.ordinal;
+		if(index >= metaObject->propertyCount() || field.name != metaObject->property(index).name())
+		{
+			index = metaObject->indexOfProperty(field.name.constData());
+			if(index < 0) qWarning() << "QAArchive:" << field.name << "is not a property of" << metaObject->className();
+		}
+		schema.targetIndices << index;
+	}
+}
+
+bool QAArchive::expect(Record record)
+{
+	forever
+	{
+		quint8 tag = 0;
+		m_stream >> tag;
+		if(m_stream.status() != QDataStream::Ok)
+		{
+			qWarning() << "QAArchive: unexpected end of the archive";
+			return false;
+		}
+		if(tag == SchemaRecord)
+		{
+			if(!readSchema()) return false;
+			continue;
+		}
+		if(tag != record)
+		{
+			qWarning() << "QAArchive: unexpected record" << tag;
+			return false;
+		}
+		return true;
+	}
+}
+
+bool QAArchive::save(const QAlgorithm& node)
+{
+	if(!writeHeader()) return false;
+	const QMetaObject* metaObject = node.metaObject();
+	const quint32 id = schemaOf(metaObject);
+	m_stream << quint8(NodeRecord) << id;
+	bool ok = true;
+	for(const Field& field: m_writtenFields[int(id)])
+	{
+		// Inputs left out are not even read, since they may be changing
+		if(!m_inputsSaved && (field.name.startsWith(QA_IN) || field.name.startsWith(QA_PORT_IN)))
+		{
+			m_stream << quint8(false);
+			continue;
+		}
+		const QVariant value = metaObject->property(field.ordinal).read(&node);
+		const bool present = value.isValid() && value.userType() == field.typeId;
+		m_stream << quint8(present);
+		if(!present) continue;
+		if(field.encoding == RawArray) rawArrayType(field.typeId)->save(m_stream, value.constData());
+		else if(!QMetaType::save(m_stream, field.typeId, value.constData()))
+		{
+			qWarning() << "QAArchive:" << field.name << "of" << node.printName() << "cannot be saved, its type has no stream operators";
+			ok = false;
+		}
+	}
+	return ok && m_stream.status() == QDataStream::Ok;
+}
+
+void QAArchive::setInputsSaved(bool saved)
+{
+	m_inputsSaved = saved;
+}
+
+bool QAArchive::load(QAlgorithm& node)
+{
+	if(!readHeader() || !expect(NodeRecord)) return false;
+	quint32 id = 0;
+	m_stream >> id;
+	if(id >= quint32(m_readSchemas.size()))
+	{
+		qWarning() << "QAArchive: node record without schema";
+		return false;
+	}
+	Schema& schema = m_readSchemas[int(id)];
+	const QMetaObject* metaObject = node.metaObject();
+	if(schema.className != metaObject->className())
+	{
+		qWarning() << "QAArchive: loading an instance of" << schema.className << "into" << node.printName();
+	}
+	resolve(schema, metaObject);
+	bool ok = true;
+	for(int k = 0; k < schema.fields.size(); ++k)
+	{
+		const Field& field = schema.fields[k];
+		quint8 present = 0;
+		m_stream >> present;
+		if(!present) continue;
+		QVariant value(field.typeId, Q_NULLPTR);
+		bool read = field.encoding == RawArray ?
+		rawArrayType(field.typeId)->load(m_stream, value.data()) :
+		QMetaType::load(m_stream, field.typeId, value.data());
+		if(!read || m_stream.status() != QDataStream::Ok)
+		{
+			qWarning() << "QAArchive:" << field.name << "cannot be loaded for" << node.printName();
+			return false;
+		}
+		const int index = schema.targetIndices[k];
+		if(index >= 0 && !metaObject->property(index).write(&node, value))
+		{
+			qWarning() << "QAArchive:" << field.name << "failed to set for" << node.printName();
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+bool QAArchive::saveGraph(const QAShrAlgorithm& node)
+{
+	if(!writeHeader()) return false;
+	const QAGraphSnapshot graph(node);
+	m_stream << quint8(GraphRecord) << quint32(graph.size()) << quint32(graph.edgeCount());
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		for(int descendant: graph.descendants(k)) m_stream << quint32(k) << quint32(descendant);
+	}
+	bool ok = m_stream.status() == QDataStream::Ok;
+	for(const auto& current: graph.nodes()) ok = save(*current) && ok;
+	return ok;
+}
+
+bool QAArchive::loadGraph(const QAShrAlgorithm& node)
+{
+	if(!readHeader() || !expect(GraphRecord)) return false;
+	const QAGraphSnapshot graph(node);
+	quint32 size = 0, edges = 0;
+	m_stream >> size >> edges;
+	if(size != quint32(graph.size()) || edges != quint32(graph.edgeCount()))
+	{
+		qWarning() << "QAArchive: the graph has" << graph.size() << "algorithms and" << graph.edgeCount()
+		<< "connections, the archive" << size << "and" << edges;
+		return false;
+	}
+	for(quint32 k = 0; k < edges; ++k)
+	{
+		quint32 from = 0, to = 0;
+		m_stream >> from >> to;
+		const auto descendants = graph.descendants(int(qMin(from, size - 1)));
+		if(from >= size || std::find(descendants.begin(), descendants.end(), int(to)) == descendants.end())
+		{
+			qWarning() << "QAArchive: the graph has not the same connections of the archive";
+			return false;
+		}
+	}
+	for(const auto& current: graph.nodes())
+	{
+		if(!load(*current)) return false;
+	}
+	return true;
+}
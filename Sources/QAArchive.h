@@ -0,0 +1,183 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QAArchive.h
+ *  Declarations for the QAArchive class.
+ */
+
+#ifndef QAArchive_h
+#define QAArchive_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+
+/**
+ * \brief Versioned binary archive of algorithm states and graphs.
+ *
+ * The archive stores the inputs, outputs, parameters and ports of algorithms,
+ * as operator<<(QDataStream&, const QAlgorithm&) does, in a compact format.
+ * The parameters of QAlgorithm itself (\e KeepInput, \e PropagationRules, ...)
+ * are not stored, since they describe how the graph is executed and are set
+ * when it is built. The format is such that:
+ * - the names and types of the properties of each class are written only
+ *   once, in a schema record, the first time an instance of that class is saved;
+ * - each property is then identified by its ordinal in the schema, and its
+ *   value is written without type tag;
+ * - arrays of numbers (QVector of integers or floating point values, and
+ *   QByteArray) are written as raw contiguous payloads.
+ *
+ * A whole graph can be saved with saveGraph(), that also stores the edges,
+ * and loaded with loadGraph() into a graph of the same shape, for instance
+ * a newly built instance of the same pipeline; the algorithms are matched by
+ * their index in QAGraphSnapshot.
+ *
+ * \code
+ * QFile file("results.qaa");
+ * file.open(QIODevice::WriteOnly);
+ * QAArchive archive(&file);
+ * archive.saveGraph(closer);
+ * \endcode
+ *
+ * \note Raw payloads are written in the byte order of the machine; an archive
+ * written with a different byte order is rejected when it is loaded.
+ *
+ * \sa QAGraphSnapshot
+ */
+class QAArchive
+{
+public:
+	/** \brief Version of the format written by this class. */
+	static const quint16 FormatVersion = 1;
+
+	/**
+	 * \brief Constructor.
+	 *
+	 * The archive header is written before the first record saved, and
+	 * it is read before the first record loaded.
+	 *
+	 * \param[in] device The device to write to or read from; it must be open.
+	 */
+	explicit QAArchive(QIODevice* device);
+
+	/**
+	 * \brief Save the state of an algorithm.
+	 *
+	 * \return Whether the state has been written successfully.
+	 */
+	bool save(const QAlgorithm& node);
+
+	/**
+	 * \brief Load the state of an algorithm.
+	 *
+	 * The next record must have been saved from an instance of the same class;
+	 * properties no longer present in the class are skipped with a warning.
+	 *
+	 * \return Whether the state has been read and assigned successfully.
+	 */
+	bool load(QAlgorithm& node);
+
+	/**
+	 * \brief Save the graph which \e node belongs to.
+	 *
+	 * The edges are saved first, as pairs of indices of QAGraphSnapshot,
+	 * then the state of every algorithm, in index order.
+	 *
+	 * \return Whether the graph has been written successfully.
+	 */
+	bool saveGraph(const QAShrAlgorithm& node);
+
+	/**
+	 * \brief Load a graph saved by saveGraph() into the graph which \e node belongs to.
+	 *
+	 * The graph must have the same shape of the saved one, i.e. the same
+	 * number of algorithms and the same edges, and it must be built in the
+	 * same order, so that its snapshot gives the same indices.
+	 *
+	 * \return Whether the graph has been read and assigned successfully.
+	 */
+	bool loadGraph(const QAShrAlgorithm& node);
+
+	/**
+	 * \brief Set whether the inputs of the algorithms are saved.
+	 *
+	 * Inputs are saved by default. Records written without them can be loaded
+	 * as usual, the inputs being left untouched. QACheckpoint leaves them out,
+	 * since the outputs of finished algorithms are enough to resume, while
+	 * their inputs may be released by a running graph as it is being saved.
+	 *
+	 * \param[in] saved Whether input and input port properties are saved.
+	 */
+	void setInputsSaved(bool saved);
+
+	/** \brief Version of the format of the archive being read, or 0 if unknown yet. */
+	quint16 formatVersion() const;
+
+private:
+	/** \brief How a property value is written. */
+	enum Encoding : quint8
+	{
+		Generic,	///< With QMetaType::save().
+		RawArray	///< As element count followed by raw bytes.
+	};
+
+	/** \brief Record tags. */
+	enum Record : quint8
+	{
+		SchemaRecord = 1,
+		NodeRecord,
+		GraphRecord
+	};
+
+	struct Field
+	{
+		int ordinal;
+		QByteArray name;
+		QByteArray typeName;
+		int typeId;
+		Encoding encoding;
+	};
+
+	struct Schema
+	{
+		QByteArray className;
+		QVector<Field> fields;
+		// Resolution of the fields against the class being loaded
+		const QMetaObject* target = Q_NULLPTR;
+		QVector<int> targetIndices;
+	};
+
+	bool writeHeader();
+	bool readHeader();
+	quint32 schemaOf(const QMetaObject* metaObject);
+	bool readSchema();
+	void resolve(Schema& schema, const QMetaObject* metaObject);
+	bool expect(Record record);
+
+	QDataStream m_stream;
+	bool m_headerWritten = false;
+	bool m_headerRead = false;
+	bool m_inputsSaved = true;
+	quint16 m_version = 0;
+	QHash<const QMetaObject*, quint32> m_writtenSchemas;
+	QVector<QVector<Field>> m_writtenFields;
+	QVector<Schema> m_readSchemas;
+};
+
+#endif /* QAArchive_h */
@@ -0,0 +1,138 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QAArrayView.h
+ *  Declarations for the QAArrayView class.
+ */
+
+#ifndef QAArrayView_h
+#define QAArrayView_h
+
+#include <QtCore>
+
+/**
+ * \brief Read-only view of a contiguous array, sharing the ownership of its memory.
+ *
+ * A view does not copy the elements: it refers to memory owned by someone
+ * else, typically a file mapped by QAMappedStore, or a QVector, and it keeps
+ * that memory alive as long as the view (or any copy of it) exists. Copying
+ * a view is as cheap as copying a shared pointer.
+ *
+ * Views can be used as inputs, so that an algorithm can consume a large
+ * array mapped from disk without deserializing it:
+ * \code
+ * QA_INPUT(QAArrayView<double>, Samples)
+ * \endcode
+ * Such an input also accepts a QVector of the same type, without copying
+ * its elements, thanks to the converters registered by registerType();
+ * the converse conversion, that copies the elements, is registered as well.
+ *
+ * \note Views of \e quint8, \e qint32, \e qint64, \e float and \e double are
+ * declared as meta-types, and their converters are registered when
+ * QAMappedStore is first used.
+ *
+ * \sa QAMappedStore
+ */
+template<typename T>
+class QAArrayView
+{
+	QSharedPointer<const void> m_owner;
+	const T* m_data = Q_NULLPTR;
+	qint64 m_size = 0;
+
+public:
+	/** \brief Type of the elements. */
+	typedef T ValueType;
+
+	/** \brief Constructs an empty view. */
+	QAArrayView() = default;
+
+	/**
+	 * \brief Constructs a view of memory owned by \e owner.
+	 *
+	 * \param[in] owner Any shared pointer keeping the memory alive.
+	 * \param[in] data Pointer to the first element.
+	 * \param[in] size Number of elements.
+	 */
+	QAArrayView(const QSharedPointer<const void>& owner, const T* data, qint64 size) :
+	m_owner(owner), m_data(data), m_size(size) {}
+
+	/** \brief Constructs a view of a vector, sharing its data. */
+	explicit QAArrayView(const QVector<T>& vector)
+	{
+		QSharedPointer<const QVector<T>> owner(new QVector<T>(vector));
+		m_owner = owner;
+		m_data = owner->constData();
+		m_size = owner->size();
+	}
+
+	/** \brief Pointer to the first element. */
+	const T* constData() const { return m_data; }
+
+	/** \brief Number of elements. */
+	qint64 size() const { return m_size; }
+
+	/** \brief Whether the view has no elements. */
+	bool isEmpty() const { return m_size == 0; }
+
+	/** \brief Element at the given position. */
+	const T& operator[](qint64 k) const { return m_data[k]; }
+
+	/** \brief Pointer to the first element. */
+	const T* begin() const { return m_data; }
+
+	/** \brief Pointer past the last element. */
+	const T* end() const { return m_data + m_size; }
+
+	/** \brief Copy the elements to a new vector. */
+	QVector<T> toVector() const
+	{
+		QVector<T> vector(int(m_size));
+		std::copy(begin(), end(), vector.begin());
+		return vector;
+	}
+
+	/**
+	 * \brief Register the conversions between QVector<T> and QAArrayView<T>.
+	 *
+	 * The meta-type of QAArrayView<T> must have been declared. This function
+	 * can be called more than once.
+	 */
+	static void registerType()
+	{
+		qRegisterMetaType<QAArrayView<T>>();
+		if(!QMetaType::hasRegisteredConverterFunction<QVector<T>, QAArrayView<T>>())
+		{
+			QMetaType::registerConverter<QVector<T>, QAArrayView<T>>([](const QVector<T>& vector) {return QAArrayView<T>(vector);});
+		}
+		if(!QMetaType::hasRegisteredConverterFunction<QAArrayView<T>, QVector<T>>())
+		{
+			QMetaType::registerConverter<QAArrayView<T>, QVector<T>>(&QAArrayView<T>::toVector);
+		}
+	}
+};
+
+Q_DECLARE_METATYPE(QAArrayView<quint8>)
+Q_DECLARE_METATYPE(QAArrayView<qint32>)
+Q_DECLARE_METATYPE(QAArrayView<qint64>)
+Q_DECLARE_METATYPE(QAArrayView<float>)
+Q_DECLARE_METATYPE(QAArrayView<double>)
+
+#endif /* QAArrayView_h */
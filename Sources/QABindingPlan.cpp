@@ -0,0 +1,163 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include "QABindingPlan.h"
+#include "QAlgorithm.h"
+
+namespace
+{
+	struct QABindingKey
+	{
+		const QMetaObject* parentClass;
+		const QMetaObject* childClass;
+		QAPropagationRules rules;
+		QString parentName;
+	};
+
+	bool operator==(const QABindingKey& a, const QABindingKey& b)
+	{
+		return a.parentClass == b.parentClass && a.childClass == b.childClass &&
+		a.parentName == b.parentName && a.rules == b.rules;
+	}
+
+	uint qHash(const QABindingKey& key, uint seed = 0)
+	{
+		uint h = ::qHash(quintptr(key.parentClass), seed) ^ ::qHash(quintptr(key.childClass), seed);
+		for(auto it = key.rules.cbegin(); it != key.rules.cend(); ++it)
+		{
+			h = 31 * h + ::qHash(it.key(), seed);
+			h = 31 * h + ::qHash(it.value(), seed);
+		}
+		return 31 * h + ::qHash(key.parentName, seed);
+	}
+
+	// Whether some parent's property is mapped to more than one child's property
+	bool hasAmbiguousRules(const QAPropagationRules& rules)
+	{
+		if(rules.isEmpty()) return false;
+		auto it = rules.cbegin();
+		for(auto next = it + 1; next != rules.cend(); it = next++)
+		{
+			if(it.key() == next.key()) return true;
+		}
+		return false;
+	}
+
+	QReadWriteLock& cacheLock()
+	{
+		static QReadWriteLock lock;
+		return lock;
+	}
+
+	QHash<QABindingKey, QABindingPlan>& cache()
+	{
+		static QHash<QABindingKey, QABindingPlan> plans;
+		return plans;
+	}
+}
+
+QABindingPlan QABindingPlan::resolve(const QAlgorithm* parent, const QAlgorithm* child)
+{
+	QABindingKey key;
+	key.parentClass = parent->metaObject();
+	key.childClass = child->metaObject();
+	key.rules = child->getPropagationRules();
+	// The parent's name matters only to disambiguate multiple destinations
+	if(hasAmbiguousRules(key.rules)) key.parentName = parent->objectName();
+	{
+		QReadLocker locker(&cacheLock());
+		auto it = cache().constFind(key);
+		if(it != cache().constEnd()) return it.value();
+	}
+	auto plan = build(parent, child);
+	QWriteLocker locker(&cacheLock());
+	cache().insert(key, plan);
+	return plan;
+}
+
+QABindingPlan QABindingPlan::build(const QAlgorithm* parent, const QAlgorithm* child)
+{
+	QABindingPlan plan;
+	const QAPropagationRules rules = child->getPropagationRules();
+	const QMetaObject* parentObj = parent->metaObject();
+	const QMetaObject* childObj = child->metaObject();
+	// Scan parent's properties and grab all the possible outputs and parameters
+	for(int k = 0; k < parentObj->propertyCount(); ++k)
+	{
+		QString parentPropName = parentObj->property(k).name();
+		// Get the parent's property base name
+		// Both output and parameter properties are checked
+		QString parentPropBaseName;
+		bool isParameter = false;
+		if(parentPropName.startsWith(QA_OUT))
+		{
+			// Output property
+			parentPropBaseName = parentPropName.mid(int(strlen(QA_OUT)));
+		}
+		else if(parentPropName.startsWith(QA_PAR))
+		{
+			// Parameter
+			parentPropBaseName = parentPropName.mid(int(strlen(QA_PAR)));
+			isParameter = true;
+		}
+		else continue;
+		// Parameters are sent only if they are explicitly mentioned in the PropagationRules
+		if(isParameter && !rules.contains(parentPropBaseName)) continue;
+		// Get the child's property base name, based on PropagationRules values
+		QString childPropBaseName;
+		if(!rules.contains(parentPropBaseName))
+		{
+			childPropBaseName = parentPropBaseName;
+		}
+		else
+		{
+			// The values associated with the given key
+			auto values = rules.values(parentPropBaseName);
+			if(values.size() > 1)
+			{
+				// If there are more than one value, then use the first one that contain the parent object name
+				values = values.filter(parent->objectName());
+				if(values.isEmpty()) continue;
+			}
+			childPropBaseName = values.first();
+		}
+		// Check if the property is in child's input or parameter properties
+		const QString childInName = QA_IN + childPropBaseName;
+		const QString childParName = QA_PAR + childPropBaseName;
+		for(int i = 0; i < childObj->propertyCount(); ++i)
+		{
+			const char* childPropName = childObj->property(i).name();
+			if(childInName == QLatin1String(childPropName) || childParName == QLatin1String(childPropName))
+			{
+				plan.m_bindings.append(Binding(k, i));
+			}
+		}
+	}
+	return plan;
+}
+
+const QVector<QABindingPlan::Binding>& QABindingPlan::bindings() const
+{
+	return m_bindings;
+}
+
+bool QABindingPlan::isEmpty() const
+{
+	return m_bindings.isEmpty();
+}
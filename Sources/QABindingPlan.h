@@ -0,0 +1,84 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QABindingPlan.h
+ *  Declarations for the QABindingPlan class.
+ */
+
+#ifndef QABindingPlan_h
+#define QABindingPlan_h
+
+#include <QtCore>
+
+class QAlgorithm;
+
+/**
+ * \brief Precompiled list of property bindings between two connected algorithms.
+ *
+ * A binding plan stores, for a given parent class, child class and set of
+ * \e PropagationRules, the pairs (source property index, destination property index)
+ * that QAlgorithm::getInput() has to transfer. The plan is resolved by scanning
+ * the meta-objects of both classes only once, then it is kept in a global cache
+ * shared by every instance; transferring the properties along an edge is then
+ * a flat loop over QMetaProperty::read() and QMetaProperty::write(), without
+ * any string handling, see QAlgorithm::sendOutputs().
+ *
+ * The cache key also contains the parent's object name, but only when the
+ * PropagationRules map a parent's property to more than one child's property,
+ * since only in that case the object name is used to choose the destination.
+ *
+ * \sa QAlgorithm::getInput, QAlgorithm::makePropagationRules
+ */
+class QABindingPlan
+{
+public:
+	/** \brief Pair (source property index, destination property index). */
+	typedef QPair<int, int> Binding;
+
+	/**
+	 * \brief Get the binding plan for the given pair of algorithms.
+	 *
+	 * The plan is looked up in the global cache, and it is resolved and
+	 * inserted in the cache if not found. This function is thread-safe.
+	 *
+	 * \param[in] parent The algorithm whose outputs and parameters are read.
+	 * \param[in] child The algorithm whose inputs and parameters are written;
+	 * its PropagationRules are used to resolve the plan.
+	 * \return The binding plan for the given pair.
+	 */
+	static QABindingPlan resolve(const QAlgorithm* parent, const QAlgorithm* child);
+
+	/**
+	 * \brief Get the list of bindings.
+	 *
+	 * \return The list of (source property index, destination property index) pairs.
+	 */
+	const QVector<Binding>& bindings() const;
+
+	/** \brief Whether the plan contains no binding at all. */
+	bool isEmpty() const;
+
+private:
+	/** \brief Scan the meta-objects of both algorithms to build the plan. */
+	static QABindingPlan build(const QAlgorithm* parent, const QAlgorithm* child);
+
+	QVector<Binding> m_bindings;
+};
+
+#endif /* QABindingPlan_h */
@@ -0,0 +1,236 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QACheckpoint.h"
+#include "QAArchive.h"
+#include "QAGraphSnapshot.h"
+#include <algorithm>
+
+namespace
+{
+	const quint32 checkpointMagic = 0x51414350; // "QACP"
+	const quint16 checkpointVersion = 1;
+
+	// Finished algorithms whose ancestors are all finished, with their outputs kept
+	QVector<bool> resumable(const QAGraphSnapshot& graph)
+	{
+		// Kahn's algorithm, so that ancestors are decided first
+		QVector<int> pending(graph.size());
+		QVector<int> order;
+		order.reserve(graph.size());
+		for(int k = 0; k < graph.size(); ++k)
+		{
+			pending[k] = graph.ancestors(k).size();
+			if(pending[k] == 0) order << k;
+		}
+		for(int i = 0; i < order.size(); ++i)
+		{
+			for(int descendant: graph.descendants(order[i]))
+			{
+				if(--pending[descendant] == 0) order << descendant;
+			}
+		}
+		QVector<bool> done(graph.size(), false);
+		for(int k: order)
+		{
+			const QAlgorithm* node = graph.node(k).data();
+			bool ok = node->isFinished() && node->getKeepOutput();
+			for(int ancestor: graph.ancestors(k)) ok = ok && done[ancestor];
+			done[k] = ok;
+		}
+		return done;
+	}
+}
+
+QACheckpoint::QACheckpoint(const QString& directory, QObject* parent) : QObject(parent), m_directory(directory)
+{
+	if(!QDir().mkpath(m_directory)) qWarning() << "QACheckpoint: cannot create" << m_directory;
+}
+
+QString QACheckpoint::filePath() const
+{
+	return QDir(m_directory).filePath("checkpoint.qac");
+}
+
+bool QACheckpoint::exists() const
+{
+	return QFile::exists(filePath());
+}
+
+bool QACheckpoint::remove()
+{
+	QMutexLocker locker(&m_lock);
+	return !exists() || QFile::remove(filePath());
+}
+
+bool QACheckpoint::save(const QAShrAlgorithm& node)
+{
+	QMutexLocker locker(&m_lock);
+	const QAGraphSnapshot graph(node);
+	const QVector<bool> done = resumable(graph);
+	QSaveFile file(filePath());
+	if(!file.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "QACheckpoint: cannot write" << filePath() << file.errorString();
+		return false;
+	}
+	// Shape of the graph and completion state...
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_6);
+	stream << checkpointMagic << checkpointVersion << quint32(graph.size()) << quint32(graph.edgeCount());
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		stream << QByteArray(graph.node(k)->metaObject()->className()) << done[k];
+	}
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		for(int descendant: graph.descendants(k)) stream << quint32(k) << quint32(descendant);
+	}
+	// ...then the state of the finished algorithms
+	QAArchive archive(&file);
+	archive.setInputsSaved(false);
+	bool ok = stream.status() == QDataStream::Ok;
+	for(int k = 0; k < graph.size() && ok; ++k)
+	{
+		if(done[k]) ok = archive.save(*graph.node(k));
+	}
+	if(!ok)
+	{
+		qWarning() << "QACheckpoint: cannot write" << filePath();
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
+
+void QACheckpoint::watch(const QAShrAlgorithm& node)
+{
+	const QWeakPointer<QAlgorithm> weak = node;
+	// Saved in the thread of the checkpoint, not in the worker that ran the algorithm
+	connect(node.data(), &QAlgorithm::justFinished, this, [this, weak]()
+			{
+				const QAShrAlgorithm strong = weak.toStrongRef();
+				if(!strong.isNull()) save(strong);
+			}, Qt::QueuedConnection);
+}
+
+bool QACheckpoint::restore(const QAShrAlgorithm& node)
+{
+	QMutexLocker locker(&m_lock);
+	QFile file(filePath());
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "QACheckpoint: cannot read" << filePath() << file.errorString();
+		return false;
+	}
+	const QAGraphSnapshot graph(node);
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_6);
+	quint32 magic = 0, size = 0, edges = 0;
+	quint16 version = 0;
+	stream >> magic >> version >> size >> edges;
+	if(magic != checkpointMagic || version != checkpointVersion)
+	{
+		qWarning() << "QACheckpoint:" << filePath() << "is not a checkpoint of a supported version";
+		return false;
+	}
+	if(size != quint32(graph.size()) || edges != quint32(graph.edgeCount()))
+	{
+		qWarning() << "QACheckpoint: the graph has not the same shape of the checkpoint";
+		return false;
+	}
+	QVector<bool> done(graph.size(), false);
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		QByteArray className;
+		bool finished = false;
+		stream >> className >> finished;
+		if(className != graph.node(k)->metaObject()->className())
+		{
+			qWarning() << "QACheckpoint: algorithm" << k << "is" << graph.node(k)->printName() << "instead of" << className;
+			return false;
+		}
+		done[k] = finished;
+	}
+	for(quint32 k = 0; k < edges; ++k)
+	{
+		quint32 from = 0, to = 0;
+		stream >> from >> to;
+		const auto descendants = graph.descendants(int(qMin(from, size - 1)));
+		if(from >= size || std::find(descendants.begin(), descendants.end(), int(to)) == descendants.end())
+		{
+			qWarning() << "QACheckpoint: the graph has not the same connections of the checkpoint";
+			return false;
+		}
+	}
+	if(stream.status() != QDataStream::Ok)
+	{
+		qWarning() << "QACheckpoint: corrupted checkpoint" << filePath();
+		return false;
+	}
+	// Restore the finished algorithms...
+	QAArchive archive(&file);
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		if(!done[k]) continue;
+		QAlgorithm* current = graph.node(k).data();
+		if(current->isStarted())
+		{
+			qWarning() << "QACheckpoint:" << current->printName() << "has already been executed";
+			return false;
+		}
+		if(!archive.load(*current)) return false;
+		current->started.storeRelease(1);
+		current->finished.storeRelease(1);
+		current->pendingInputs.storeRelease(0);
+	}
+	// ...and deliver their outputs to the others
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		if(done[k]) continue;
+		const QAShrAlgorithm& current = graph.node(k);
+		int pending = 0;
+		for(int ancestor: graph.ancestors(k))
+		{
+			if(done[ancestor]) current->fetchInput(graph.node(ancestor));
+			else ++pending;
+		}
+		current->pendingInputs.storeRelease(pending);
+	}
+	return true;
+}
+
+int QACheckpoint::resume(const QAShrAlgorithm& node)
+{
+	const QAGraphSnapshot graph(node);
+	QAAdjacencyList frontier;
+	for(const auto& current: graph.nodes())
+	{
+		if(!current->isStarted() && current->allInputsReady()) frontier << current;
+	}
+	for(const auto& current: frontier)
+	{
+		// An algorithm may have been started by another one in the meantime
+		if(current->isStarted()) continue;
+		if(current->getParallelExecution()) current->parallelExecution();
+		else current->serialExecution();
+	}
+	return frontier.size();
+}
@@ -0,0 +1,144 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QACheckpoint.h
+ *  Declarations for the QACheckpoint class.
+ */
+
+#ifndef QACheckpoint_h
+#define QACheckpoint_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+
+/**
+ * \brief Checkpoint and resume of partially executed graphs.
+ *
+ * A checkpoint stores, in a directory, which algorithms of a graph have
+ * finished and the state of each of them (see QAArchive), so that after a
+ * crash or a restart the same graph can be built again, restored from the
+ * checkpoint, and executed from the frontier of the unfinished algorithms,
+ * instead of from the leaves.
+ *
+ * An algorithm is recorded as finished only if its outputs are kept (see
+ * \e KeepOutput), since otherwise they may have already been released, and
+ * if all its ancestors are recorded as finished too; any other algorithm
+ * runs again after resuming. Algorithms are identified by their index in
+ * QAGraphSnapshot, thus the graph must be built again in the same order.
+ *
+ * Checkpoints can be saved explicitly with save(), or automatically each
+ * time one of the algorithms given to watch() finishes; the checkpoint file
+ * is replaced atomically, so that a crash while saving leaves the previous
+ * checkpoint intact.
+ *
+ * \code
+ * QACheckpoint checkpoint("/var/lib/pipeline");
+ * auto closer = buildGraph();
+ * if(checkpoint.exists()) checkpoint.restore(closer);
+ * checkpoint.watch(expensiveStage);
+ * QAGraphExecutor executor(closer);
+ * executor.execute();  // or checkpoint.resume(closer);
+ * \endcode
+ *
+ * \note A restored graph can be executed by a QAGraphExecutor as it is, since
+ * the executor only runs the algorithms not finished.
+ *
+ * \note Unless \e KeepInput is set, parallelExecution() and serialExecution()
+ * close the connections of the algorithms that delivered their outputs, so
+ * a checkpoint saved while they run would not match the graph built again;
+ * checkpoints of running graphs should be taken under a QAGraphExecutor,
+ * that leaves the connections untouched.
+ *
+ * \sa QAArchive, QAGraphSnapshot
+ */
+class QACheckpoint : public QObject
+{
+	Q_OBJECT
+
+	QString m_directory;
+	QMutex m_lock;
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] directory Directory of the checkpoint; it is created if needed.
+	 * \param[in] parent Parent object.
+	 */
+	explicit QACheckpoint(const QString& directory, QObject* parent = Q_NULLPTR);
+
+	/** \brief Path of the checkpoint file. */
+	QString filePath() const;
+
+	/** \brief Whether a checkpoint has been saved in the directory. */
+	bool exists() const;
+
+	/** \brief Delete the checkpoint saved in the directory, if any. */
+	bool remove();
+
+	/**
+	 * \brief Save a checkpoint of the graph which \e node belongs to.
+	 *
+	 * This function can be called while the graph is running, e.g. from
+	 * watch(); only algorithms already finished are recorded, with their
+	 * parameters and outputs, but not their inputs, that a running graph
+	 * may be releasing (see QAArchive::setInputsSaved()). The outputs of
+	 * the recorded algorithms are kept, hence they are only read.
+	 *
+	 * \return Whether the checkpoint has been saved successfully.
+	 */
+	bool save(const QAShrAlgorithm& node);
+
+	/**
+	 * \brief Save a checkpoint each time \e node finishes.
+	 *
+	 * The checkpoint is saved in the thread this instance lives in, through a
+	 * queued connection, so that no worker of a QAGraphExecutor is held up;
+	 * that thread must run an event loop.
+	 *
+	 * \param[in] node Any algorithm of the graph; the whole graph is saved.
+	 */
+	void watch(const QAShrAlgorithm& node);
+
+	/**
+	 * \brief Restore the saved checkpoint into the graph which \e node belongs to.
+	 *
+	 * The graph must have the same shape of the saved one, and must not have
+	 * been executed yet. The algorithms recorded as finished get their saved
+	 * state and are marked as finished, without emitting any signal; their
+	 * outputs are delivered to their unfinished descendants, so that only the
+	 * unfinished algorithms are left to run.
+	 *
+	 * \return Whether the checkpoint has been restored successfully.
+	 */
+	bool restore(const QAShrAlgorithm& node);
+
+	/**
+	 * \brief Start the unfinished algorithms whose ancestors are all finished.
+	 *
+	 * Each of them is started with QAlgorithm::parallelExecution() or
+	 * QAlgorithm::serialExecution(), according to its \e ParallelExecution parameter.
+	 *
+	 * \return The number of algorithms started.
+	 */
+	int resume(const QAShrAlgorithm& node);
+};
+
+#endif /* QACheckpoint_h */
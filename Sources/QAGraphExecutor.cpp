@@ -0,0 +1,495 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include "QAGraphExecutor.h"
+#include "QABindingPlan.h"
+#include "QAProfiler.h"
+#include "QAGraphSnapshot.h"
+#include "QAThreadPool.h"
+
+class QAGraphExecutor::Worker : public QRunnable
+{
+	QAGraphExecutor* executor;
+	int id;
+public:
+	Worker(QAGraphExecutor* executor, int id) : executor(executor), id(id) {}
+	void run() override
+	{
+		QAThreadPool::prepareCurrentThread(executor->m_pool);
+		executor->work(id);
+	}
+};
+
+QAGraphExecutor::QAGraphExecutor(QAShrAlgorithm node, QObject* parent) :
+QObject(parent), m_pool(QThreadPool::globalInstance())
+{
+	// Compute the adjacency lists once
+	const QAGraphSnapshot graph(node);
+	std::vector<NodeState> nodes(size_t(graph.size()));
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		nodes[size_t(k)].node = graph.node(k);
+		for(int ancestor: graph.ancestors(k)) nodes[size_t(k)].ancestors << ancestor;
+		for(int descendant: graph.descendants(k)) nodes[size_t(k)].descendants << descendant;
+	}
+	m_nodes.swap(nodes);
+}
+
+QAGraphExecutor::~QAGraphExecutor()
+{
+	waitForDone();
+	// Do not leave the algorithms with a dangling profiler
+	if(!m_ownProfiler.isNull()) setProfiler(Q_NULLPTR);
+}
+
+int QAGraphExecutor::nodeCount() const
+{
+	return int(m_nodes.size());
+}
+
+bool QAGraphExecutor::isRunning() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_running;
+}
+
+bool QAGraphExecutor::waitForDone(int msecs) const
+{
+	QMutexLocker locker(&m_mutex);
+	QElapsedTimer timer;
+	timer.start();
+	while(m_running || m_notifying > 0)
+	{
+		if(msecs < 0)
+		{
+			m_doneCondition.wait(&m_mutex);
+		}
+		else
+		{
+			qint64 left = msecs - timer.elapsed();
+			if(left <= 0) return false;
+			m_doneCondition.wait(&m_mutex, (unsigned long)left);
+		}
+	}
+	return true;
+}
+
+bool QAGraphExecutor::rearm()
+{
+	QMutexLocker locker(&m_mutex);
+	if(m_running)
+	{
+		qWarning() << "QAGraphExecutor: cannot rearm a running graph";
+		return false;
+	}
+	for(auto& state: m_nodes) state.node->rearmNode();
+	return true;
+}
+
+void QAGraphExecutor::setManaged(bool managed)
+{
+	for(auto& state: m_nodes) state.node->managed = managed;
+}
+
+void QAGraphExecutor::setThreadPool(QThreadPool* pool)
+{
+	QMutexLocker locker(&m_mutex);
+	if(m_running)
+	{
+		qWarning() << "QAGraphExecutor: cannot change the thread pool of a running graph";
+		return;
+	}
+	m_pool = pool ? pool : QThreadPool::globalInstance();
+	for(auto& state: m_nodes) state.node->setThreadPool(pool);
+}
+
+QThreadPool* QAGraphExecutor::threadPool() const
+{
+	return m_pool;
+}
+
+void QAGraphExecutor::setSchedulingPolicy(SchedulingPolicy policy)
+{
+	QMutexLocker locker(&m_mutex);
+	if(m_running)
+	{
+		qWarning() << "QAGraphExecutor: cannot change the scheduling policy of a running graph";
+		return;
+	}
+	m_policy = policy;
+}
+
+QAGraphExecutor::SchedulingPolicy QAGraphExecutor::schedulingPolicy() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_policy;
+}
+
+bool QAGraphExecutor::hasReady() const
+{
+	return m_policy == CriticalPathScheduling ? !m_readyHeap.empty() : !m_ready.isEmpty();
+}
+
+void QAGraphExecutor::pushReady(int index)
+{
+	if(m_policy != CriticalPathScheduling)
+	{
+		m_ready.enqueue(index);
+		return;
+	}
+	m_readyHeap.push_back(index);
+	std::push_heap(m_readyHeap.begin(), m_readyHeap.end(), [this](int a, int b) {return m_ranks[a] < m_ranks[b];});
+}
+
+int QAGraphExecutor::popReady()
+{
+	if(m_policy != CriticalPathScheduling) return m_ready.dequeue();
+	std::pop_heap(m_readyHeap.begin(), m_readyHeap.end(), [this](int a, int b) {return m_ranks[a] < m_ranks[b];});
+	const int index = m_readyHeap.back();
+	m_readyHeap.pop_back();
+	return index;
+}
+
+void QAGraphExecutor::computeRanks()
+{
+	const int n = int(m_nodes.size());
+	// Algorithms of unknown cost weigh as the average one
+	QVector<qint64> costs(n);
+	qint64 known = 0, total = 0;
+	for(int k = 0; k < n; ++k)
+	{
+		costs[k] = m_nodes[size_t(k)].node->getCost();
+		if(costs[k] >= 0)
+		{
+			total += costs[k];
+			++known;
+		}
+	}
+	const qint64 average = known > 0 ? qMax(qint64(1), total / known) : 1;
+	for(qint64& cost: costs)
+	{
+		if(cost < 0) cost = average;
+	}
+	// Visit the graph from the sinks upwards, in reverse topological order
+	m_ranks.fill(0, n);
+	QVector<int> waiting(n), order;
+	order.reserve(n);
+	for(int k = 0; k < n; ++k)
+	{
+		waiting[k] = m_nodes[size_t(k)].descendants.size();
+		if(waiting[k] == 0) order << k;
+	}
+	for(int i = 0; i < order.size(); ++i)
+	{
+		const int k = order[i];
+		qint64 longest = 0;
+		for(int descendant: m_nodes[size_t(k)].descendants) longest = qMax(longest, m_ranks[descendant]);
+		m_ranks[k] = costs[k] + longest;
+		for(int ancestor: m_nodes[size_t(k)].ancestors)
+		{
+			if(--waiting[ancestor] == 0) order << ancestor;
+		}
+	}
+}
+
+void QAGraphExecutor::setProfiler(QAProfiler* profiler)
+{
+	m_profiler = profiler;
+	for(auto& state: m_nodes) state.node->setProfiler(profiler);
+}
+
+void QAGraphExecutor::setTracePath(const QString& path)
+{
+	m_tracePath = path;
+	if(!path.isEmpty() && m_profiler == Q_NULLPTR)
+	{
+		m_ownProfiler.reset(new QAProfiler);
+		setProfiler(m_ownProfiler.data());
+	}
+}
+
+void QAGraphExecutor::execute()
+{
+	QMutexLocker locker(&m_mutex);
+	if(m_running)
+	{
+		qWarning() << "QAGraphExecutor: the graph is already running";
+		return;
+	}
+	// Algorithms not waiting for any input are ready to start
+	m_ready.clear();
+	m_readyHeap.clear();
+	if(m_policy == CriticalPathScheduling) computeRanks();
+	int remaining = 0;
+	QVector<int> ready;
+	for(int k = 0; k < int(m_nodes.size()); ++k)
+	{
+		const QAlgorithm* node = m_nodes[size_t(k)].node.data();
+		if(node->isFinished()) continue;
+		// Inputs awaited from algorithms that the executor does not run would never arrive
+		int waiting = 0;
+		for(int ancestor: m_nodes[size_t(k)].ancestors)
+		{
+			if(!m_nodes[size_t(ancestor)].node->isFinished()) ++waiting;
+		}
+		if(node->pendingInputs.loadAcquire() > waiting)
+		{
+			qWarning() << "QAGraphExecutor:" << node->printName() << "waits for algorithms outside the graph";
+			return;
+		}
+		if(node->allInputsReady())
+		{
+			if(node->profiler) m_nodes[size_t(k)].node->enqueuedAt = node->profiler->now();
+			ready << k;
+		}
+		++remaining;
+	}
+	if(remaining == 0)
+	{
+		locker.unlock();
+		Q_EMIT finished();
+		return;
+	}
+	if(ready.isEmpty())
+	{
+		qWarning() << "QAGraphExecutor: no algorithm of the graph is ready to start";
+		return;
+	}
+	m_remaining.storeRelease(remaining);
+	m_activeWorkers = qMax(1, qMin(m_pool->maxThreadCount(), remaining));
+	if(m_policy == WorkStealingScheduling)
+	{
+		// Deal the ready algorithms to the workers
+		m_queues.resize(size_t(m_activeWorkers));
+		for(auto& queue: m_queues)
+		{
+			if(!queue) queue.reset(new WorkerQueue);
+			queue->tasks.clear();
+		}
+		for(int k = 0; k < ready.size(); ++k) m_queues[size_t(k % m_activeWorkers)]->tasks.push_back(ready[k]);
+	}
+	else
+	{
+		for(int index: ready) pushReady(index);
+	}
+	// Start the workers
+	if(!m_tracePath.isEmpty() && m_profiler != Q_NULLPTR) m_profiler->clear();
+	setManaged(true);
+	m_running = true;
+	for(int k = 0; k < m_activeWorkers; ++k) m_pool->start(new Worker(this, k));
+}
+
+void QAGraphExecutor::work(int worker)
+{
+	if(m_policy == WorkStealingScheduling) stealWork(worker);
+	else forever
+	{
+		int index;
+		{
+			QMutexLocker locker(&m_mutex);
+			while(!hasReady() && m_remaining.loadAcquire() > 0) m_readyCondition.wait(&m_mutex);
+			if(m_remaining.loadAcquire() == 0) break;
+			index = popReady();
+		}
+		process(index, worker);
+	}
+	// The last worker to leave notifies the completion
+	QMutexLocker locker(&m_mutex);
+	if(--m_activeWorkers > 0) return;
+	setManaged(false);
+	locker.unlock();
+	if(!m_tracePath.isEmpty() && m_profiler != Q_NULLPTR) m_profiler->writeChromeTrace(m_tracePath);
+	// Slots connected to finished() may already rearm and execute the graph,
+	// but waitForDone() returns only after the signal, so that the executor
+	// cannot be destroyed while it is being emitted
+	locker.relock();
+	m_running = false;
+	++m_notifying;
+	locker.unlock();
+	Q_EMIT finished();
+	locker.relock();
+	--m_notifying;
+	m_doneCondition.wakeAll();
+}
+
+void QAGraphExecutor::stealWork(int worker)
+{
+	forever
+	{
+		int index = takeTask(worker);
+		if(index < 0)
+		{
+			// Nothing to do: sleep until some algorithm is pushed, checking again
+			// under the lock, so that no wake-up can be missed
+			QMutexLocker locker(&m_mutex);
+			if(m_remaining.loadAcquire() == 0) break;
+			m_sleeping.ref();
+			index = takeTask(worker);
+			if(index < 0) m_readyCondition.wait(&m_mutex);
+			m_sleeping.deref();
+			if(index < 0) continue;
+		}
+		process(index, worker);
+	}
+}
+
+int QAGraphExecutor::takeTask(int worker)
+{
+	// Newest algorithm from the own queue...
+	{
+		WorkerQueue& own = *m_queues[size_t(worker)];
+		QMutexLocker locker(&own.lock);
+		if(!own.tasks.empty())
+		{
+			const int index = own.tasks.back();
+			own.tasks.pop_back();
+			return index;
+		}
+	}
+	// ...otherwise the oldest from another worker
+	const int workers = int(m_queues.size());
+	for(int k = 1; k < workers; ++k)
+	{
+		WorkerQueue& victim = *m_queues[size_t((worker + k) % workers)];
+		QMutexLocker locker(&victim.lock);
+		if(!victim.tasks.empty())
+		{
+			const int index = victim.tasks.front();
+			victim.tasks.pop_front();
+			return index;
+		}
+	}
+	return -1;
+}
+
+void QAGraphExecutor::pushTasks(int worker, const QVector<int>& tasks)
+{
+	if(tasks.isEmpty()) return;
+	{
+		WorkerQueue& own = *m_queues[size_t(worker)];
+		QMutexLocker locker(&own.lock);
+		for(int index: tasks) own.tasks.push_back(index);
+	}
+	if(m_sleeping.loadAcquire() > 0)
+	{
+		QMutexLocker locker(&m_mutex);
+		if(tasks.size() > 1) m_readyCondition.wakeAll();
+		else m_readyCondition.wakeOne();
+	}
+}
+
+void QAGraphExecutor::process(int index, int worker)
+{
+	// Descendants inlined by this worker, instead of going through the ready queue
+	QVector<int> inlined;
+	inlined << index;
+	QVector<int> ready, queued;
+	for(int i = 0; i < inlined.size(); ++i)
+	{
+		const QAlgorithm* node = m_nodes[size_t(inlined[i])].node.data();
+		complete(inlined[i], ready);
+		queued.clear();
+		if(m_policy == CriticalPathScheduling)
+		{
+			// Inline the most critical descendants first
+			std::sort(ready.begin(), ready.end(), [this](int a, int b) {return m_ranks[a] > m_ranks[b];});
+		}
+		if(!node->getParallelExecution())
+		{
+			// Serial execution of the descendants
+			inlined += ready;
+		}
+		else if(node->getTaskGranularity() > 0)
+		{
+			// Keep a batch of cheap descendants, see QAlgorithm::improveTree()
+			const qint64 granularity = node->getTaskGranularity();
+			qint64 total = 0;
+			for(int descendant: ready)
+			{
+				qint64 cost = m_nodes[size_t(descendant)].node->getCost();
+				if(cost < 0) cost = granularity;
+				if(total + cost <= granularity)
+				{
+					inlined << descendant;
+					total += cost;
+				}
+				else queued << descendant;
+			}
+		}
+		else queued = ready;
+		// Continue with a ready descendant, if no other one is left to this worker
+		if(i + 1 == inlined.size() && !queued.isEmpty()) inlined << queued.takeFirst();
+		const bool last = !m_remaining.deref();
+		if(m_policy == WorkStealingScheduling)
+		{
+			pushTasks(worker, queued);
+			if(last)
+			{
+				QMutexLocker locker(&m_mutex);
+				m_readyCondition.wakeAll();
+			}
+			continue;
+		}
+		QMutexLocker locker(&m_mutex);
+		for(int descendant: queued) pushReady(descendant);
+		if(last || queued.size() > 1) m_readyCondition.wakeAll();
+		else if(queued.size() == 1) m_readyCondition.wakeOne();
+	}
+}
+
+void QAGraphExecutor::complete(int index, QVector<int>& ready)
+{
+	NodeState& state = m_nodes[size_t(index)];
+	QAlgorithm* node = state.node.data();
+	// Perform the core part of the algorithm in this thread
+	node->setStarted();
+	node->perform();
+	node->setFinished();
+	const qint64 begin = node->profiler ? node->profiler->now() : 0;
+	// Count the consumers of each output, in order to release it after its last transfer
+	QVector<QABindingPlan> plans;
+	if(!node->getKeepOutput())
+	{
+		QAAdjacencyList children;
+		for(int descendant: state.descendants) children << m_nodes[size_t(descendant)].node;
+		node->countConsumers(children, plans);
+	}
+	// Transfer outputs and collect the descendants that became ready
+	ready.clear();
+	for(int k = 0; k < state.descendants.size(); ++k)
+	{
+		const int descendant = state.descendants[k];
+		NodeState& child = m_nodes[size_t(descendant)];
+		{
+			// Algorithms with many parents may receive inputs concurrently
+			QMutexLocker locker(&child.inputLock);
+			child.node->fetchInput(state.node);
+		}
+		// Release before the child can start, so that it does not need to detach
+		if(!plans.isEmpty()) node->releaseConsumedOutputs(plans[k]);
+		if(!child.node->pendingInputs.deref())
+		{
+			if(child.node->profiler) child.node->enqueuedAt = child.node->profiler->now();
+			ready << descendant;
+		}
+	}
+	node->clearConsumers();
+	if(!node->getKeepInput()) node->releaseInputs();
+	if(node->profiler) node->profiler->record(QAProfiler::Propagation, node, begin, node->profiler->now());
+}
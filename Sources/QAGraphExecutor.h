@@ -0,0 +1,290 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QAGraphExecutor.h
+ *  Declarations for the QAGraphExecutor class.
+ */
+
+#ifndef QAGraphExecutor_h
+#define QAGraphExecutor_h
+
+#include <QtCore>
+#include <vector>
+#include <deque>
+#include <memory>
+#include "QAlgorithm.h"
+
+class QAProfiler;
+
+/**
+ * \brief Scheduler that runs a whole algorithm graph on worker threads.
+ *
+ * QAlgorithm::parallelExecution() drives the execution recursively, and each
+ * completed algorithm goes back to the event loop of its owning thread
+ * before its descendants can start. QAGraphExecutor instead takes the whole
+ * graph at once: it computes the adjacency of every node on construction,
+ * decrements the atomic counter of the remaining inputs of each node
+ * (see QAlgorithm::allInputsReady()), and lets the worker threads push the
+ * nodes that become ready directly to a ready queue, without any round-trip
+ * through the event loop.
+ *
+ * A worker runs the descendants that become ready right away, without going
+ * through the ready queue, when the \e ParallelExecution parameter of the
+ * completed algorithm is false; when its \e TaskGranularity is positive, the
+ * worker keeps as many ready descendants as fit in that cost, and queues the
+ * others (see QAlgorithm::improveTree()).
+ *
+ * In any case, when none of the ready descendants is run inline, the worker
+ * continues with the first one, so that its inputs are still hot in the
+ * cache, and leaves the others to the other workers. The order in which
+ * ready algorithms are started is chosen by the scheduling policy, see
+ * setSchedulingPolicy().
+ *
+ * Outputs are still transferred with QAlgorithm::getInput(), the signals
+ * QAlgorithm::justStarted() and QAlgorithm::justFinished() are still emitted
+ * (from the worker thread), but QAlgorithm::propagateExecution() is skipped
+ * for the nodes managed by the executor. Connections are never closed by the
+ * executor, regardless of the \e KeepInput parameter, so the graph topology
+ * is preserved.
+ *
+ * Only nodes that are not finished yet are run; the graph structure is taken
+ * on construction, so the executor must be created after every connection
+ * has been set. Once the execution has ended, rearm() makes the graph ready
+ * to run again, so that the same executor can process many data items
+ * without building the graph again. When only some parameters change,
+ * QAlgorithm::markDirty() rearms just the affected subgraph instead, and
+ * execute() runs only the dirty algorithms.
+ *
+ * \code
+ * QAGraphExecutor executor(closer);
+ * for(const auto& item: stream)
+ * {
+ * 	source->setInItem(item);
+ * 	executor.execute();
+ * 	executor.waitForDone();
+ * 	consume(closer->getOutResult());
+ * 	executor.rearm();
+ * }
+ * \endcode
+ *
+ * \sa QAlgorithm::parallelExecution
+ */
+class QAGraphExecutor : public QObject
+{
+	Q_OBJECT
+
+public:
+	/** \brief Order in which the ready algorithms are started. */
+	enum SchedulingPolicy
+	{
+		FifoScheduling,			///< In the order they become ready.
+		CriticalPathScheduling,	///< Highest upward rank first, see setSchedulingPolicy().
+		WorkStealingScheduling	///< Per-worker queues, see setSchedulingPolicy().
+	};
+	Q_ENUM(SchedulingPolicy)
+
+private:
+	struct NodeState
+	{
+		QAShrAlgorithm node;
+		QVector<int> ancestors;
+		QVector<int> descendants;
+		QMutex inputLock;
+	};
+
+	struct WorkerQueue
+	{
+		QMutex lock;
+		std::deque<int> tasks;
+	};
+
+	std::vector<NodeState> m_nodes;
+
+	QThreadPool* m_pool;
+	QAProfiler* m_profiler = Q_NULLPTR;
+	QScopedPointer<QAProfiler> m_ownProfiler;
+	SchedulingPolicy m_policy = FifoScheduling;
+	QString m_tracePath;
+	mutable QMutex m_mutex;
+	QWaitCondition m_readyCondition;
+	mutable QWaitCondition m_doneCondition;
+	QQueue<int> m_ready;
+	std::vector<int> m_readyHeap;
+	QVector<qint64> m_ranks;
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	QAtomicInt m_sleeping;
+	QAtomicInt m_remaining;
+	int m_activeWorkers = 0;
+	int m_notifying = 0;
+	bool m_running = false;
+
+	class Worker;
+
+	bool hasReady() const;
+	void pushReady(int index);
+	int popReady();
+	void computeRanks();
+	int takeTask(int worker);
+	void pushTasks(int worker, const QVector<int>& tasks);
+
+	void work(int worker);
+	void stealWork(int worker);
+	void process(int index, int worker);
+	void complete(int index, QVector<int>& ready);
+	void setManaged(bool managed);
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * Takes the structure of the graph which \e node belongs to.
+	 *
+	 * \param[in] node Any algorithm of the graph to execute.
+	 * \param[in] parent Parent object.
+	 */
+	explicit QAGraphExecutor(QAShrAlgorithm node, QObject* parent = Q_NULLPTR);
+
+	/**
+	 * \brief Destructor.
+	 *
+	 * Waits for the running execution, if any, to end.
+	 */
+	~QAGraphExecutor();
+
+	/** \brief Number of algorithms in the graph. */
+	int nodeCount() const;
+
+	/**
+	 * \brief Run the graph on the given thread pool.
+	 *
+	 * The workers of the executor are started on \e pool, instead of the global
+	 * QThreadPool, so that the graph is isolated from the other ones; the pool
+	 * is also given to every algorithm of the graph, see QAlgorithm::setThreadPool().
+	 * The pool is not owned and must outlive the executor.
+	 *
+	 * \param[in] pool The thread pool, or a null pointer to use the global one.
+	 *
+	 * \sa QAThreadPool
+	 */
+	void setThreadPool(QThreadPool* pool);
+
+	/** \brief The thread pool the workers are started on. */
+	QThreadPool* threadPool() const;
+
+	/**
+	 * \brief Set the order in which the ready algorithms are started.
+	 *
+	 * With FifoScheduling (the default) algorithms are started in the order
+	 * they become ready. With CriticalPathScheduling the ready algorithm with
+	 * the highest \e upward \e rank is started first, where the upward rank of
+	 * an algorithm is its cost plus the highest upward rank among its descendants,
+	 * i.e. the length of the longest path from the algorithm to the end of the
+	 * graph. Starting first the algorithms on the critical path reduces the
+	 * overall execution time of graphs with branches of different lengths.
+	 *
+	 * Ranks are computed at the beginning of each execution, from the costs
+	 * returned by QAlgorithm::getCost(), i.e. either declared with the \e CostHint
+	 * parameter or measured on the previous executions; algorithms of unknown cost
+	 * are given the average of the known costs.
+	 *
+	 * With WorkStealingScheduling each worker has a queue of its own, and
+	 * there is no lock shared by all the workers: the descendants that become
+	 * ready are pushed to the queue of the worker that completed their last
+	 * ancestor, that takes them back in last-in first-out order, while idle
+	 * workers steal the oldest algorithms from the queues of the other ones.
+	 * This policy scales best with many workers and many tiny algorithms.
+	 *
+	 * \param[in] policy The scheduling policy.
+	 */
+	void setSchedulingPolicy(SchedulingPolicy policy);
+
+	/** \brief The scheduling policy. */
+	SchedulingPolicy schedulingPolicy() const;
+
+	/**
+	 * \brief Attach a profiler to every algorithm of the graph.
+	 *
+	 * \param[in] profiler The profiler, or a null pointer to stop profiling.
+	 *
+	 * \sa QAProfiler, QAlgorithm::setProfiler
+	 */
+	void setProfiler(QAProfiler* profiler);
+
+	/**
+	 * \brief Write a Chrome trace of each execution to the given path.
+	 *
+	 * At the end of each execution the events recorded by the attached profiler
+	 * are written to \e path, see QAProfiler::writeChromeTrace(); if no profiler
+	 * is attached, the executor creates and attaches its own. The events are
+	 * cleared at the beginning of each execution.
+	 *
+	 * \param[in] path Path of the trace file, or an empty string to disable the trace.
+	 */
+	void setTracePath(const QString& path);
+
+	/** \brief Whether the graph is being executed. */
+	bool isRunning() const;
+
+	/**
+	 * \brief Wait for the execution to end.
+	 *
+	 * \param[in] msecs Maximum waiting time in milliseconds, or -1 to wait forever.
+	 * \return Whether the execution ended before the timeout.
+	 */
+	bool waitForDone(int msecs = -1) const;
+
+	/**
+	 * \brief Make the graph ready to run again.
+	 *
+	 * Clears the completion state of every algorithm of the graph and resets
+	 * their inputs, keeping connections, parameters and outputs; see
+	 * QAlgorithm::rearm(). Nothing is allocated, since the graph structure
+	 * computed on construction is reused.
+	 *
+	 * \return Whether the graph has been rearmed, i.e. it was not running.
+	 */
+	bool rearm();
+
+	/**
+	 * \brief Start executing the graph.
+	 *
+	 * Nothing is started, and a warning is printed, when some unfinished
+	 * algorithm waits for an input that no algorithm of the graph can deliver,
+	 * e.g. from an ancestor connected after the construction of the executor,
+	 * since the execution would never end.
+	 *
+	 * \note The calling function will \b NOT freeze waiting for completion.
+	 *
+	 * \sa waitForDone, finished
+	 */
+	Q_SLOT void execute();
+
+Q_SIGNALS:
+	/**
+	 * \brief Signal emitted when every algorithm of the graph has finished.
+	 *
+	 * The graph is no longer running when the signal is emitted, thus a
+	 * slot can rearm() and execute() it again right away.
+	 *
+	 * \note The signal is emitted from a worker thread.
+	 */
+	Q_SIGNAL void finished();
+};
+
+#endif /* QAGraphExecutor_h */
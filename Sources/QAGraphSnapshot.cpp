@@ -0,0 +1,110 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include "QAGraphSnapshot.h"
+
+QAGraphSnapshot::QAGraphSnapshot()
+{
+	m_ancestorOffsets << 0;
+	m_descendantOffsets << 0;
+}
+
+QAGraphSnapshot::QAGraphSnapshot(const QAShrAlgorithm& node) : QAGraphSnapshot()
+{
+	if(node.isNull()) return;
+	// Breadth-first visit; the array of nodes is also the queue
+	m_nodes << node;
+	m_indices.insert(node.data(), 0);
+	for(int k = 0; k < m_nodes.size(); ++k)
+	{
+		const QAlgorithm* current = m_nodes[k].data();
+		for(const auto& relatives: {&current->getDescendantList(), &current->getAncestorList()})
+		{
+			for(const auto& relative: *relatives)
+			{
+				if(m_indices.contains(relative.data())) continue;
+				m_indices.insert(relative.data(), m_nodes.size());
+				m_nodes << relative;
+			}
+		}
+	}
+	// Store the adjacency in compressed sparse row format
+	m_ancestorOffsets.reserve(m_nodes.size() + 1);
+	m_descendantOffsets.reserve(m_nodes.size() + 1);
+	for(const auto& current: m_nodes)
+	{
+		for(const auto& ancestor: current->getAncestorList()) m_ancestorIndices << m_indices.value(ancestor.data());
+		for(const auto& descendant: current->getDescendantList()) m_descendantIndices << m_indices.value(descendant.data());
+		m_ancestorOffsets << m_ancestorIndices.size();
+		m_descendantOffsets << m_descendantIndices.size();
+	}
+}
+
+int QAGraphSnapshot::size() const
+{
+	return m_nodes.size();
+}
+
+bool QAGraphSnapshot::isEmpty() const
+{
+	return m_nodes.isEmpty();
+}
+
+const QAShrAlgorithm& QAGraphSnapshot::node(int index) const
+{
+	return m_nodes[index];
+}
+
+const QVector<QAShrAlgorithm>& QAGraphSnapshot::nodes() const
+{
+	return m_nodes;
+}
+
+int QAGraphSnapshot::indexOf(const QAlgorithm* node) const
+{
+	return m_indices.value(node, -1);
+}
+
+QAGraphSnapshot::Range QAGraphSnapshot::ancestors(int index) const
+{
+	const int* data = m_ancestorIndices.constData();
+	return Range(data + m_ancestorOffsets[index], data + m_ancestorOffsets[index + 1]);
+}
+
+QAGraphSnapshot::Range QAGraphSnapshot::descendants(int index) const
+{
+	const int* data = m_descendantIndices.constData();
+	return Range(data + m_descendantOffsets[index], data + m_descendantOffsets[index + 1]);
+}
+
+int QAGraphSnapshot::edgeCount() const
+{
+	return m_descendantIndices.size();
+}
+
+QAFlatRepresentation QAGraphSnapshot::toFlatRepresentation() const
+{
+	QAFlatRepresentation tree;
+	for(int k = 0; k < m_nodes.size(); ++k)
+	{
+		QSet<QAShrAlgorithm>& children = tree[m_nodes[k]];
+		for(int descendant: descendants(k)) children << m_nodes[descendant];
+	}
+	return tree;
+}
@@ -0,0 +1,134 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QAGraphSnapshot.h
+ *  Declarations for the QAGraphSnapshot class.
+ */
+
+#ifndef QAGraphSnapshot_h
+#define QAGraphSnapshot_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+
+/**
+ * \brief Compact, index-based picture of an algorithm graph.
+ *
+ * The snapshot is taken with an iterative breadth-first traversal, that
+ * visits every algorithm connected to the starting one, in linear time and
+ * without recursion, so that graphs of any size can be handled. The
+ * algorithms are stored in a contiguous array, in the order they are
+ * visited, and each algorithm is identified by its index in that array;
+ * ancestors and descendants are stored in compressed sparse row format,
+ * i.e. as contiguous lists of indices.
+ *
+ * The snapshot does not follow the changes of the graph: it has to be taken
+ * again after any connection is set or closed. Since the traversal follows
+ * the order the connections have been set, the same graph always gives the
+ * same snapshot.
+ *
+ * \code
+ * QAGraphSnapshot graph = closer->snapshot();
+ * for(int k = 0; k < graph.size(); ++k)
+ * {
+ * 	for(int descendant: graph.descendants(k))
+ * 		qInfo() << graph.node(k)->printName() << "->" << graph.node(descendant)->printName();
+ * }
+ * \endcode
+ *
+ * \sa QAlgorithm::snapshot, QAlgorithm::flattenTree
+ */
+class QAGraphSnapshot
+{
+public:
+	/** \brief Range of node indices, that can be used in a range-based for loop. */
+	class Range
+	{
+		const int* m_begin;
+		const int* m_end;
+	public:
+		/** \brief Constructor. */
+		Range(const int* begin, const int* end) : m_begin(begin), m_end(end) {}
+		/** \brief Pointer to the first index. */
+		const int* begin() const { return m_begin; }
+		/** \brief Pointer past the last index. */
+		const int* end() const { return m_end; }
+		/** \brief Number of indices. */
+		int size() const { return int(m_end - m_begin); }
+		/** \brief Whether the range is empty. */
+		bool isEmpty() const { return m_begin == m_end; }
+		/** \brief Index at the given position. */
+		int operator[](int k) const { return m_begin[k]; }
+	};
+
+	/** \brief Constructs an empty snapshot. */
+	QAGraphSnapshot();
+
+	/**
+	 * \brief Takes a snapshot of the graph which \e node belongs to.
+	 *
+	 * \param[in] node Any algorithm of the graph; it gets index 0.
+	 */
+	explicit QAGraphSnapshot(const QAShrAlgorithm& node);
+
+	/** \brief Number of algorithms in the graph. */
+	int size() const;
+
+	/** \brief Whether the snapshot contains no algorithm. */
+	bool isEmpty() const;
+
+	/** \brief The algorithm with the given index. */
+	const QAShrAlgorithm& node(int index) const;
+
+	/** \brief Every algorithm, in index order. */
+	const QVector<QAShrAlgorithm>& nodes() const;
+
+	/**
+	 * \brief Index of the given algorithm.
+	 *
+	 * \return The index of \e node, or -1 if it does not belong to the graph.
+	 */
+	int indexOf(const QAlgorithm* node) const;
+
+	/** \brief Indices of the ancestors of the algorithm with the given index. */
+	Range ancestors(int index) const;
+
+	/** \brief Indices of the descendants of the algorithm with the given index. */
+	Range descendants(int index) const;
+
+	/** \brief Number of connections in the graph. */
+	int edgeCount() const;
+
+	/**
+	 * \brief Convert to the map-based flat representation.
+	 *
+	 * \sa QAlgorithm::flattenTree
+	 */
+	QAFlatRepresentation toFlatRepresentation() const;
+
+private:
+	QVector<QAShrAlgorithm> m_nodes;
+	QHash<const QAlgorithm*, int> m_indices;
+	QVector<int> m_ancestorOffsets;
+	QVector<int> m_ancestorIndices;
+	QVector<int> m_descendantOffsets;
+	QVector<int> m_descendantIndices;
+};
+
+#endif /* QAGraphSnapshot_h */
@@ -0,0 +1,388 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QAMappedStore.h"
+#include "QABindingPlan.h"
+#include "QAGraphSnapshot.h"
+
+namespace
+{
+	const quint32 storeMagic = 0x51414d53; // "QAMS"
+	const quint16 storeVersion = 1;
+	const qint64 alignment = 64;
+
+	// Element types supported by QAArrayView
+	struct ViewType
+	{
+		int vectorType;
+		bool (*save)(QAMappedStore&, const QString&, const QVariant&);
+		QVariant (*view)(const QAMappedStore&, const QString&);
+	};
+
+	template<typename T>
+	ViewType viewType()
+	{
+		ViewType type;
+		type.vectorType = qMetaTypeId<QVector<T>>();
+		type.save = [](QAMappedStore& store, const QString& key, const QVariant& value)
+		{
+			return store.write(key, *static_cast<const QVector<T>*>(value.constData()));
+		};
+		type.view = [](const QAMappedStore& store, const QString& key)
+		{
+			return QVariant::fromValue(store.view<T>(key));
+		};
+		return type;
+	}
+
+	const QVector<ViewType>& viewTypes()
+	{
+		static const QVector<ViewType> types = []()
+		{
+			QAArrayView<quint8>::registerType();
+			QAArrayView<qint32>::registerType();
+			QAArrayView<qint64>::registerType();
+			QAArrayView<float>::registerType();
+			QAArrayView<double>::registerType();
+			return QVector<ViewType>{viewType<quint8>(), viewType<qint32>(), viewType<qint64>(), viewType<float>(), viewType<double>()};
+		}();
+		return types;
+	}
+
+	const ViewType* viewTypeOf(int vectorType)
+	{
+		for(const auto& type: viewTypes())
+		{
+			if(type.vectorType == vectorType) return &type;
+		}
+		return Q_NULLPTR;
+	}
+
+	QString indexPath(const QString& path)
+	{
+		return path + ".index";
+	}
+}
+
+QAMappedStore::QAMappedStore(const QString& path) : m_path(path)
+{
+	viewTypes();
+}
+
+QAMappedStore::~QAMappedStore()
+{
+	close();
+}
+
+bool QAMappedStore::open(QIODevice::OpenMode mode)
+{
+	close();
+	m_file.reset(new QFile(m_path));
+	if(mode == QIODevice::WriteOnly)
+	{
+		if(!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+		{
+			qWarning() << "QAMappedStore: cannot create" << m_path << m_file->errorString();
+			m_file.reset();
+			return false;
+		}
+		QDataStream stream(m_file.data());
+		stream << storeMagic << storeVersion << quint8(QSysInfo::ByteOrder);
+		m_mode = mode;
+		return true;
+	}
+	if(mode != QIODevice::ReadOnly)
+	{
+		qWarning() << "QAMappedStore: the store can only be opened for reading or writing";
+		m_file.reset();
+		return false;
+	}
+	// Read the index...
+	QFile index(indexPath(m_path));
+	if(!index.open(QIODevice::ReadOnly) || !m_file->open(QIODevice::ReadOnly))
+	{
+		qWarning() << "QAMappedStore: cannot open" << m_path;
+		m_file.reset();
+		return false;
+	}
+	// The data file starts with the same header as the index
+	quint32 magic = 0;
+	quint16 version = 0;
+	quint8 byteOrder = 0;
+	QDataStream data(m_file.data());
+	data >> magic >> version >> byteOrder;
+	if(data.status() != QDataStream::Ok || magic != storeMagic || version != storeVersion ||
+	   byteOrder != quint8(QSysInfo::ByteOrder))
+	{
+		qWarning() << "QAMappedStore:" << m_path << "is not a data file of a supported version or byte order";
+		m_file.reset();
+		return false;
+	}
+	QDataStream stream(&index);
+	stream.setVersion(QDataStream::Qt_5_6);
+	quint32 count = 0;
+	stream >> magic >> version >> byteOrder >> count;
+	if(magic != storeMagic || version != storeVersion || byteOrder != quint8(QSysInfo::ByteOrder))
+	{
+		qWarning() << "QAMappedStore:" << m_path << "has an unsupported version or byte order";
+		m_file.reset();
+		return false;
+	}
+	for(quint32 k = 0; k < count && stream.status() == QDataStream::Ok; ++k)
+	{
+		QString key;
+		Entry entry;
+		stream >> key >> entry.typeName >> entry.elementSize >> entry.offset >> entry.count;
+		m_entries.insert(key, entry);
+	}
+	if(stream.status() != QDataStream::Ok)
+	{
+		qWarning() << "QAMappedStore: corrupted index of" << m_path;
+		m_entries.clear();
+		m_file.reset();
+		return false;
+	}
+	// Every array must lie within the data file, that may have been truncated
+	const qint64 size = m_file->size();
+	for(auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+	{
+		const Entry& entry = it.value();
+		if(entry.offset < 0 || entry.count < 0 || entry.elementSize == 0 || entry.offset > size ||
+		   entry.count > (size - entry.offset) / qint64(entry.elementSize))
+		{
+			qWarning() << "QAMappedStore:" << it.key() << "exceeds the data file" << m_path;
+			m_entries.clear();
+			m_file.reset();
+			return false;
+		}
+	}
+	// ...then map the whole data file
+	m_base = m_file->size() > 0 ? m_file->map(0, m_file->size()) : Q_NULLPTR;
+	if(m_base == Q_NULLPTR && !m_entries.isEmpty())
+	{
+		qWarning() << "QAMappedStore: cannot map" << m_path << m_file->errorString();
+		m_entries.clear();
+		m_file.reset();
+		return false;
+	}
+	m_mode = mode;
+	return true;
+}
+
+bool QAMappedStore::close()
+{
+	bool ok = true;
+	if(m_mode == QIODevice::WriteOnly)
+	{
+		ok = m_file->flush();
+		QFile index(indexPath(m_path));
+		if(index.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		{
+			QDataStream stream(&index);
+			stream.setVersion(QDataStream::Qt_5_6);
+			stream << storeMagic << storeVersion << quint8(QSysInfo::ByteOrder) << quint32(m_entries.size());
+			for(auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+			{
+				stream << it.key() << it.value().typeName << it.value().elementSize << it.value().offset << it.value().count;
+			}
+			ok = ok && stream.status() == QDataStream::Ok;
+		}
+		else ok = false;
+		if(!ok) qWarning() << "QAMappedStore: cannot write the index of" << m_path;
+	}
+	// Views of the mapped file keep it open
+	m_file.reset();
+	m_base = Q_NULLPTR;
+	m_entries.clear();
+	m_mode = QIODevice::NotOpen;
+	return ok;
+}
+
+bool QAMappedStore::isOpen() const
+{
+	return m_mode != QIODevice::NotOpen;
+}
+
+QStringList QAMappedStore::keys() const
+{
+	return m_entries.keys();
+}
+
+bool QAMappedStore::contains(const QString& key) const
+{
+	return m_entries.contains(key);
+}
+
+bool QAMappedStore::writeRaw(const QString& key, const char* typeName, size_t elementSize, const void* data, qint64 count)
+{
+	if(m_mode != QIODevice::WriteOnly)
+	{
+		qWarning() << "QAMappedStore: cannot write" << key << ", the store is not open for writing";
+		return false;
+	}
+	// Align each array, so that the mapped elements are suitably aligned
+	const qint64 position = m_file->size();
+	const qint64 offset = (position + alignment - 1) / alignment * alignment;
+	const QByteArray padding(int(offset - position), '\0');
+	const qint64 bytes = qint64(elementSize) * count;
+	if(!m_file->seek(position) || m_file->write(padding) != padding.size() ||
+	   m_file->write(static_cast<const char*>(data), bytes) != bytes)
+	{
+		qWarning() << "QAMappedStore: cannot write" << key << m_file->errorString();
+		return false;
+	}
+	Entry entry;
+	entry.typeName = typeName;
+	entry.elementSize = quint32(elementSize);
+	entry.offset = offset;
+	entry.count = count;
+	m_entries.insert(key, entry);
+	return true;
+}
+
+const void* QAMappedStore::mapRaw(const QString& key, const char* typeName, size_t elementSize, qint64& count) const
+{
+	if(m_mode != QIODevice::ReadOnly) return Q_NULLPTR;
+	auto it = m_entries.constFind(key);
+	if(it == m_entries.constEnd()) return Q_NULLPTR;
+	if(it.value().typeName != typeName || it.value().elementSize != elementSize)
+	{
+		qWarning() << "QAMappedStore:" << key << "holds elements of type" << it.value().typeName << ", not" << typeName;
+		return Q_NULLPTR;
+	}
+	count = it.value().count;
+	return m_base + it.value().offset;
+}
+
+QVariant QAMappedStore::variantView(const QString& key, int vectorType) const
+{
+	const ViewType* type = viewTypeOf(vectorType);
+	return type ? type->view(*this, key) : QVariant();
+}
+
+QString QAMappedStore::keyOf(int index, const char* property)
+{
+	return QString::number(index) + '/' + QLatin1String(property);
+}
+
+int QAMappedStore::saveOutputs(const QAShrAlgorithm& node)
+{
+	const QAGraphSnapshot graph(node);
+	int saved = 0;
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		const QAlgorithm* current = graph.node(k).data();
+		const QMetaObject* metaObject = current->metaObject();
+		for(int i = 0; i < metaObject->propertyCount(); ++i)
+		{
+			const QMetaProperty prop = metaObject->property(i);
+			if(qstrncmp(prop.name(), QA_OUT, qstrlen(QA_OUT)) != 0) continue;
+			const ViewType* type = viewTypeOf(prop.userType());
+			if(type == Q_NULLPTR) continue;
+			if(!type->save(*this, keyOf(k, prop.name()), prop.read(current))) return -1;
+			++saved;
+		}
+	}
+	return saved;
+}
+
+int QAMappedStore::deliverOutputs(const QAShrAlgorithm& node) const
+{
+	if(m_mode != QIODevice::ReadOnly)
+	{
+		qWarning() << "QAMappedStore: the store is not open for reading";
+		return -1;
+	}
+	const QAGraphSnapshot graph(node);
+	// Kahn's algorithm, so that ancestors are decided first
+	QVector<int> pending(graph.size());
+	QVector<int> order;
+	order.reserve(graph.size());
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		pending[k] = graph.ancestors(k).size();
+		if(pending[k] == 0) order << k;
+	}
+	for(int i = 0; i < order.size(); ++i)
+	{
+		for(int descendant: graph.descendants(order[i]))
+		{
+			if(--pending[descendant] == 0) order << descendant;
+		}
+	}
+	// Algorithms with stored outputs, whose ancestors are all precomputed too, are skipped
+	QVector<bool> precomputed(graph.size(), false);
+	for(int k: order)
+	{
+		const QAlgorithm* current = graph.node(k).data();
+		const QMetaObject* metaObject = current->metaObject();
+		bool stored = false;
+		for(int i = 0; i < metaObject->propertyCount() && !stored; ++i)
+		{
+			stored = contains(keyOf(k, metaObject->property(i).name()));
+		}
+		for(int ancestor: graph.ancestors(k)) stored = stored && precomputed[ancestor];
+		if(stored && current->isStarted())
+		{
+			qWarning() << "QAMappedStore:" << current->printName() << "has already been executed";
+			return -1;
+		}
+		precomputed[k] = stored;
+	}
+	int delivered = 0;
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		QAlgorithm* child = graph.node(k).data();
+		if(precomputed[k])
+		{
+			child->started.storeRelease(1);
+			child->finished.storeRelease(1);
+			child->pendingInputs.storeRelease(0);
+			continue;
+		}
+		int waiting = 0;
+		for(int ancestor: graph.ancestors(k))
+		{
+			if(!precomputed[ancestor])
+			{
+				++waiting;
+				continue;
+			}
+			QAlgorithm* parent = graph.node(ancestor).data();
+			const QMetaObject* parentObj = parent->metaObject();
+			for(const auto& binding: QABindingPlan::resolve(parent, child).bindings())
+			{
+				const QMetaProperty source = parentObj->property(binding.first);
+				const QString key = keyOf(ancestor, source.name());
+				if(!contains(key)) continue;
+				// The view is converted to a copy if the input is not a view
+				const QMetaProperty destination = child->metaObject()->property(binding.second);
+				if(!destination.write(child, variantView(key, source.userType())))
+				{
+					qWarning() << "QAMappedStore:" << destination.name() << "failed to set for" << child->printName();
+					return -1;
+				}
+				++delivered;
+			}
+		}
+		child->pendingInputs.storeRelease(waiting);
+	}
+	return delivered;
+}
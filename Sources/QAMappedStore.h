@@ -0,0 +1,176 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QAMappedStore.h
+ *  Declarations for the QAMappedStore class.
+ */
+
+#ifndef QAMappedStore_h
+#define QAMappedStore_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+#include "QAArrayView.h"
+
+/**
+ * \brief File-backed store of large arrays, loaded by memory mapping.
+ *
+ * The store writes arrays of numbers as raw contiguous blocks into a data
+ * file, aligned to 64 bytes, and their names, types and positions into an
+ * index file next to it (the same path with the suffix \e .index). Once
+ * the store has been closed, it can be opened for reading: the data file is
+ * mapped in memory, and each array is returned as a QAArrayView of the mapped
+ * region, so that nothing is read nor copied until the elements are accessed.
+ *
+ * The outputs of a whole graph can be saved with saveOutputs(), and later
+ * delivered to the descendants of a graph of the same shape with
+ * deliverOutputs(), e.g. to skip precomputed stages at start-up. Outputs of
+ * type QVector<T> are saved, for the element types supported by QAArrayView;
+ * descendants receive a QAArrayView<T> if their input is declared so, without
+ * any copy, or a copy of the array if their input is a QVector<T>.
+ *
+ * \code
+ * QAMappedStore store("stages.bin");
+ * store.open(QIODevice::ReadOnly);
+ * store.deliverOutputs(closer);
+ * \endcode
+ *
+ * \note The arrays are written in the byte order of the machine; a store
+ * written with a different byte order, or by an unsupported version of the
+ * format, is rejected when it is opened.
+ *
+ * \sa QAArrayView, QAArchive
+ */
+class QAMappedStore
+{
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] path Path of the data file.
+	 */
+	explicit QAMappedStore(const QString& path);
+
+	/** \brief Destructor; calls close(). */
+	~QAMappedStore();
+
+	/**
+	 * \brief Open the store.
+	 *
+	 * \param[in] mode Either QIODevice::WriteOnly, to create a new store, or
+	 * QIODevice::ReadOnly, to map an existing one. In read mode, a store whose
+	 * index refers to bytes beyond the end of the data file (e.g. truncated by
+	 * a crash) is rejected.
+	 * \return Whether the store has been opened successfully.
+	 */
+	bool open(QIODevice::OpenMode mode);
+
+	/** \brief Close the store; in write mode, the index file is written. */
+	bool close();
+
+	/** \brief Whether the store is open. */
+	bool isOpen() const;
+
+	/** \brief Names of the stored arrays. */
+	QStringList keys() const;
+
+	/** \brief Whether an array with the given name is stored. */
+	bool contains(const QString& key) const;
+
+	/**
+	 * \brief Store an array.
+	 *
+	 * \param[in] key Name of the array; it replaces any array with the same name.
+	 * \param[in] data The elements.
+	 * \return Whether the array has been written successfully.
+	 */
+	template<typename T>
+	bool write(const QString& key, const QVector<T>& data)
+	{
+		return writeRaw(key, QMetaType::typeName(qMetaTypeId<T>()), sizeof(T), data.constData(), data.size());
+	}
+
+	/**
+	 * \brief Get a stored array.
+	 *
+	 * \param[in] key Name of the array.
+	 * \return A view of the mapped array, or an empty view if no array of
+	 * type \e T is stored with that name.
+	 */
+	template<typename T>
+	QAArrayView<T> view(const QString& key) const
+	{
+		qint64 size = 0;
+		const void* data = mapRaw(key, QMetaType::typeName(qMetaTypeId<T>()), sizeof(T), size);
+		if(data == Q_NULLPTR) return QAArrayView<T>();
+		return QAArrayView<T>(m_file, static_cast<const T*>(data), size);
+	}
+
+	/**
+	 * \brief Store the outputs of every algorithm of the graph which \e node belongs to.
+	 *
+	 * Each array is named after the index of its algorithm in QAGraphSnapshot
+	 * and the name of the output property, e.g. "3/algout_Samples".
+	 *
+	 * \return The number of arrays stored, or -1 on failure.
+	 */
+	int saveOutputs(const QAShrAlgorithm& node);
+
+	/**
+	 * \brief Skip the precomputed algorithms, delivering their stored outputs.
+	 *
+	 * An algorithm of the graph which \e node belongs to is precomputed if
+	 * some of its outputs are stored, and all its ancestors are precomputed
+	 * too. Precomputed algorithms are marked as finished, without emitting any
+	 * signal, and their stored outputs are assigned to the bound inputs of
+	 * their other descendants, as QAlgorithm::getInput() would do; outputs
+	 * not stored are not delivered. Then only the other algorithms are left
+	 * to run, e.g. by a QAGraphExecutor. The graph must have the same shape
+	 * of the one saved by saveOutputs(), and must not have been executed yet.
+	 *
+	 * \return The number of inputs assigned, or -1 on failure.
+	 */
+	int deliverOutputs(const QAShrAlgorithm& node) const;
+
+	/** \brief Name of the array holding an output, see saveOutputs(). */
+	static QString keyOf(int index, const char* property);
+
+private:
+	struct Entry
+	{
+		QByteArray typeName;
+		quint32 elementSize;
+		qint64 offset;
+		qint64 count;
+	};
+
+	bool writeRaw(const QString& key, const char* typeName, size_t elementSize, const void* data, qint64 count);
+	const void* mapRaw(const QString& key, const char* typeName, size_t elementSize, qint64& count) const;
+	QVariant variantView(const QString& key, int vectorType) const;
+
+	QString m_path;
+	QIODevice::OpenMode m_mode = QIODevice::NotOpen;
+	QHash<QString, Entry> m_entries;
+	// Shared with the views, that keep the file mapped
+	QSharedPointer<QFile> m_file;
+	const uchar* m_base = Q_NULLPTR;
+};
+
+#endif /* QAMappedStore_h */
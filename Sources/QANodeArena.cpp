@@ -0,0 +1,78 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QANodeArena.h"
+
+QANodeArena::QANodeArena(QANodePool* pool) : m_pool(pool ? pool : QANodePool::globalInstance())
+{
+}
+
+QANodeArena::~QANodeArena()
+{
+	release();
+}
+
+void QANodeArena::add(const QAShrAlgorithm& node)
+{
+	if(!node.isNull()) m_nodes << node;
+}
+
+const QAAdjacencyList& QANodeArena::nodes() const
+{
+	return m_nodes;
+}
+
+int QANodeArena::size() const
+{
+	return m_nodes.size();
+}
+
+bool QANodeArena::release()
+{
+	for(const auto& node: m_nodes)
+	{
+		if(node->isStarted() && !node->isFinished())
+		{
+			qWarning() << "QANodeArena:" << node->printName() << "is still running, nothing released";
+			return false;
+		}
+	}
+	QSet<const QAlgorithm*> owned;
+	owned.reserve(m_nodes.size());
+	for(const auto& node: m_nodes) owned.insert(node.data());
+	for(const auto& node: m_nodes)
+	{
+		// Connections leaving the arena must be closed on both sides
+		const QAAdjacencyList ancestors = node->ancestors;
+		for(const auto& ancestor: ancestors)
+		{
+			if(!owned.contains(ancestor.data())) QAlgorithm::closeConnection(ancestor, node);
+		}
+		const QAAdjacencyList descendants = node->descendants;
+		for(const auto& descendant: descendants)
+		{
+			if(!owned.contains(descendant.data())) QAlgorithm::closeConnection(node, descendant);
+		}
+		// The others are dropped all together, breaking the reference cycles
+		node->dropConnections();
+	}
+	m_nodes.clear();
+	return true;
+}
@@ -0,0 +1,109 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QANodeArena.h
+ *  Declarations for the QANodeArena class.
+ */
+
+#ifndef QANodeArena_h
+#define QANodeArena_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+#include "QANodePool.h"
+
+/**
+ * \brief Owner of the algorithms of a graph, releasing them all at once.
+ *
+ * Connected algorithms hold shared pointers to each other, thus a graph is
+ * only destroyed after every connection has been closed. An arena keeps a
+ * reference to each algorithm created through it, and release() closes every
+ * connection and drops the references in a single step, so that the whole
+ * graph goes back to the pool (or is deleted) without visiting it connection
+ * by connection.
+ *
+ * \code
+ * QANodeArena arena;
+ * auto source = arena.create<Reader>({{"Item", item}});
+ * auto sink = arena.create<Writer>();
+ * QAlgorithm::setConnection(source, sink);
+ * ...
+ * arena.release(); // also done by the destructor
+ * \endcode
+ *
+ * \sa QANodePool
+ */
+class QANodeArena
+{
+	QANodePool* m_pool;
+	QAAdjacencyList m_nodes;
+
+	Q_DISABLE_COPY(QANodeArena)
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] pool The pool the algorithms are taken from.
+	 */
+	explicit QANodeArena(QANodePool* pool = QANodePool::globalInstance());
+
+	/** \brief Destructor; calls release(). */
+	~QANodeArena();
+
+	/**
+	 * \brief Create an algorithm owned by this arena.
+	 *
+	 * The algorithm is taken from the pool with \e createPooled(),
+	 * see QA_IMPL_CREATE.
+	 *
+	 * \param[in] parameters Name-value parameter/input pairs.
+	 * \return Shared pointer to the new algorithm.
+	 */
+	template<class T>
+	QSharedPointer<T> create(const QAPropertyMap& parameters = QAPropertyMap())
+	{
+		auto node = T::createPooled(parameters, m_pool);
+		m_nodes << node;
+		return node;
+	}
+
+	/** \brief Make the arena own an algorithm created elsewhere. */
+	void add(const QAShrAlgorithm& node);
+
+	/** \brief The algorithms owned by the arena. */
+	const QAAdjacencyList& nodes() const;
+
+	/** \brief Number of algorithms owned by the arena. */
+	int size() const;
+
+	/**
+	 * \brief Close every connection of the owned algorithms and drop them.
+	 *
+	 * Connections with algorithms not owned by the arena are closed with
+	 * QAlgorithm::closeConnection(), the others are simply forgotten.
+	 *
+	 * \return False if some algorithm is still running, in which case nothing
+	 * is released.
+	 */
+	bool release();
+};
+
+#endif /* QANodeArena_h */
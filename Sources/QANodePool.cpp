@@ -0,0 +1,127 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QANodePool.h"
+#include "QAlgorithm.h"
+
+Q_GLOBAL_STATIC(QANodePool, globalNodePool)
+
+QANodePool::QANodePool(int capacity, QObject* parent) : QObject(parent), m_capacity(qMax(0, capacity))
+{
+}
+
+QANodePool::~QANodePool()
+{
+	clear();
+}
+
+QANodePool* QANodePool::globalInstance()
+{
+	return globalNodePool();
+}
+
+void QANodePool::setCapacity(int capacity)
+{
+	QMutexLocker locker(&m_lock);
+	m_capacity = qMax(0, capacity);
+}
+
+int QANodePool::capacity() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_capacity;
+}
+
+int QANodePool::available(const QMetaObject* metaObject) const
+{
+	QMutexLocker locker(&m_lock);
+	return m_free.value(FreeListKey(metaObject, QThread::currentThread())).size();
+}
+
+void QANodePool::clear()
+{
+	QHash<FreeListKey, QVector<QAlgorithm*>> free;
+	{
+		QMutexLocker locker(&m_lock);
+		free.swap(m_free);
+	}
+	for(auto it = free.cbegin(); it != free.cend(); ++it)
+	{
+		for(QAlgorithm* node: it.value())
+		{
+			// Instances of other threads must be deleted by their own thread
+			if(it.key().second == QThread::currentThread()) delete node;
+			else node->deleteLater();
+		}
+	}
+}
+
+QAlgorithm* QANodePool::acquire(const QMetaObject* metaObject)
+{
+	QMutexLocker locker(&m_lock);
+	auto it = m_free.find(FreeListKey(metaObject, QThread::currentThread()));
+	if(it == m_free.end() || it.value().isEmpty()) return Q_NULLPTR;
+	QAlgorithm* node = it.value().last();
+	it.value().removeLast();
+	return node;
+}
+
+void QANodePool::adopt(QAlgorithm* node)
+{
+	const QMetaObject* metaObject = node->metaObject();
+	{
+		QMutexLocker locker(&m_lock);
+		if(m_defaults.contains(metaObject)) return;
+	}
+	Defaults defaults;
+	for(int k = 0; k < metaObject->propertyCount(); ++k)
+	{
+		const QMetaProperty prop = metaObject->property(k);
+		if(qstrncmp(prop.name(), QA_PAR, qstrlen(QA_PAR)) == 0) defaults << qMakePair(k, prop.read(node));
+	}
+	QMutexLocker locker(&m_lock);
+	if(!m_defaults.contains(metaObject)) m_defaults.insert(metaObject, defaults);
+}
+
+void QANodePool::release(QAlgorithm* node)
+{
+	Defaults defaults;
+	{
+		QMutexLocker locker(&m_lock);
+		if(m_free.value(FreeListKey(node->metaObject(), node->thread())).size() >= m_capacity)
+		{
+			locker.unlock();
+			node->deleteLater();
+			return;
+		}
+		defaults = m_defaults.value(node->metaObject());
+	}
+	// Clean up outside the lock, then make the instance available
+	node->recycle();
+	for(const auto& value: defaults) node->metaObject()->property(value.first).write(node, value.second);
+	QMutexLocker locker(&m_lock);
+	m_free[FreeListKey(node->metaObject(), node->thread())] << node;
+}
+
+void QANodePool::dispose(const QPointer<QANodePool>& pool, QAlgorithm* node)
+{
+	if(pool.isNull()) node->deleteLater();
+	else pool->release(node);
+}
@@ -0,0 +1,145 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QANodePool.h
+ *  Declarations for the QANodePool class.
+ */
+
+#ifndef QANodePool_h
+#define QANodePool_h
+
+#include <QtCore>
+
+class QAlgorithm;
+
+/**
+ * \brief Free lists of algorithm instances, to be recycled by \e createPooled().
+ *
+ * The \e create() function defined by QA_IMPL_CREATE allocates a new instance
+ * each time, and the instance is deleted with QObject::deleteLater() when its
+ * last shared pointer goes away. The \e createPooled() function defined by the
+ * same macro takes the instance from a pool instead, if one of the same class
+ * is available, and gives it back to the pool when its last shared pointer
+ * goes away, so that graphs created and destroyed at a high rate do not
+ * allocate memory nor post deferred deletions.
+ *
+ * An instance given back to the pool is cleaned up: its connections with
+ * other algorithms and the connections of its signals are closed, its inputs
+ * are reset (see QA_INPUT), its outputs are cleared, its parameters are
+ * restored to the values they had when the first instance of the class was
+ * allocated, and the weak self-reference, the thread pool and the profiler
+ * are forgotten. The \e createPooled() function then calls setup(),
+ * setParameters() and init() as \e create() does, so setup() must be safe to
+ * call more than once on the same instance.
+ *
+ * Each pool keeps separate free lists for each class and thread, so that an
+ * instance is only reused in the thread it belongs to; instances beyond the
+ * capacity of a free list are deleted as usual.
+ *
+ * \code
+ * for(const auto& item: items)
+ * {
+ * 	auto source = Reader::createPooled({{"Item", item}});
+ * 	auto sink = Writer::createPooled();
+ * 	QAlgorithm::setConnection(source, sink);
+ * 	...
+ * }
+ * \endcode
+ *
+ * \note Instances created by \e createPooled() have no parent object. A pool
+ * should outlive the instances taken from it; if it does not, they are
+ * deleted as usual.
+ *
+ * \sa QANodeArena, QA_IMPL_CREATE
+ */
+class QANodePool : public QObject
+{
+	Q_OBJECT
+
+	/** \brief Default values of the parameters of a class, by property index. */
+	typedef QVector<QPair<int, QVariant>> Defaults;
+	typedef QPair<const QMetaObject*, QThread*> FreeListKey;
+
+	mutable QMutex m_lock;
+	int m_capacity;
+	QHash<FreeListKey, QVector<QAlgorithm*>> m_free;
+	QHash<const QMetaObject*, Defaults> m_defaults;
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] capacity Maximum number of free instances for each class and thread.
+	 * \param[in] parent Parent object.
+	 */
+	explicit QANodePool(int capacity = 1024, QObject* parent = Q_NULLPTR);
+
+	/** \brief Destructor; free instances are deleted. */
+	~QANodePool();
+
+	/** \brief The pool used by default by \e createPooled(). */
+	static QANodePool* globalInstance();
+
+	/** \brief Set the maximum number of free instances for each class and thread. */
+	void setCapacity(int capacity);
+
+	/** \brief Maximum number of free instances for each class and thread. */
+	int capacity() const;
+
+	/** \brief Number of free instances of the given class, belonging to the calling thread. */
+	int available(const QMetaObject* metaObject) const;
+
+	/** \brief Delete every free instance. */
+	void clear();
+
+	/**
+	 * \brief Take a free instance of the given class.
+	 *
+	 * \return A cleaned up instance belonging to the calling thread, or a
+	 * null pointer if none is available.
+	 */
+	QAlgorithm* acquire(const QMetaObject* metaObject);
+
+	/**
+	 * \brief Register an instance just allocated by \e createPooled().
+	 *
+	 * The first instance of each class is used to record the default values of
+	 * the parameters, that are restored when instances are recycled.
+	 */
+	void adopt(QAlgorithm* node);
+
+	/**
+	 * \brief Clean up an instance and keep it for reuse.
+	 *
+	 * If the free list is full, the instance is deleted with QObject::deleteLater().
+	 */
+	void release(QAlgorithm* node);
+
+	/**
+	 * \brief Deleter of the shared pointers returned by \e createPooled().
+	 *
+	 * \param[in] pool The pool the instance has been taken from; if it no
+	 * longer exists, the instance is deleted with QObject::deleteLater().
+	 * \param[in] node The instance no longer referenced.
+	 */
+	static void dispose(const QPointer<QANodePool>& pool, QAlgorithm* node);
+};
+
+#endif /* QANodePool_h */
@@ -0,0 +1,299 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include "QAPipeline.h"
+#include "QAGraphSnapshot.h"
+#include "QAThreadPool.h"
+
+class QAPipeline::Task : public QRunnable
+{
+	QAPipeline* pipeline;
+	const QThreadPool* pool;
+	Firing firing;
+public:
+	Task(QAPipeline* pipeline, const QThreadPool* pool, Firing&& firing) :
+	pipeline(pipeline), pool(pool), firing(std::move(firing)) {}
+	void run() override
+	{
+		QAThreadPool::prepareCurrentThread(pool);
+		pipeline->fire(firing);
+	}
+};
+
+namespace
+{
+	// Whether the waiting time given in milliseconds is over
+	bool waitFor(QWaitCondition& condition, QMutex* mutex, const QElapsedTimer& timer, int msecs)
+	{
+		if(msecs < 0) return condition.wait(mutex);
+		qint64 left = msecs - timer.elapsed();
+		if(left <= 0) return false;
+		return condition.wait(mutex, (unsigned long)left);
+	}
+}
+
+QAPipeline::QAPipeline(QAShrAlgorithm node, int capacity, QObject* parent) :
+QObject(parent), m_capacity(qMax(1, capacity)), m_pool(QThreadPool::globalInstance())
+{
+	const QAGraphSnapshot graph(node);
+	std::vector<Stage> stages(size_t(graph.size()));
+	int k;
+	for(k = 0; k < graph.size(); ++k) stages[size_t(k)].node = graph.node(k);
+	// Each connection becomes a queue; incoming edges follow the order of the ancestors
+	for(k = 0; k < int(stages.size()); ++k)
+	{
+		QAlgorithm* child = stages[size_t(k)].node.data();
+		for(int ancestor: graph.ancestors(k))
+		{
+			Edge edge;
+			edge.from = ancestor;
+			edge.to = k;
+			edge.plan = QABindingPlan::resolve(graph.node(ancestor).data(), child);
+			stages[size_t(k)].inEdges << m_edges.size();
+			stages[size_t(edge.from)].outEdges << m_edges.size();
+			m_edges << edge;
+		}
+		if(!child->portLinks.isEmpty())
+		{
+			qWarning() << "QAPipeline: typed port connections of" << child->printName() << "are not pipelined";
+		}
+	}
+	for(k = 0; k < int(stages.size()); ++k)
+	{
+		if(stages[size_t(k)].inEdges.isEmpty()) m_sources << k;
+		if(stages[size_t(k)].outEdges.isEmpty()) m_sinks << k;
+		// Descendants are served by the pipeline, not by propagateExecution()
+		stages[size_t(k)].node->managed = true;
+	}
+	m_stages.swap(stages);
+}
+
+QAPipeline::~QAPipeline()
+{
+	QMutexLocker locker(&m_mutex);
+	m_closed = true;
+	m_stopping = true;
+	m_spaceCondition.wakeAll();
+	m_resultCondition.wakeAll();
+	while(m_activeTasks > 0) m_idleCondition.wait(&m_mutex);
+	for(auto& stage: m_stages) stage.node->managed = false;
+}
+
+void QAPipeline::setThreadPool(QThreadPool* pool)
+{
+	QMutexLocker locker(&m_mutex);
+	m_pool = pool ? pool : QThreadPool::globalInstance();
+}
+
+QThreadPool* QAPipeline::threadPool() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_pool;
+}
+
+int QAPipeline::capacity() const
+{
+	return m_capacity;
+}
+
+int QAPipeline::inFlight() const
+{
+	QMutexLocker locker(&m_mutex);
+	return int(m_pushed - m_popped);
+}
+
+QAAdjacencyList QAPipeline::sources() const
+{
+	QAAdjacencyList list;
+	for(int index: m_sources) list << m_stages[size_t(index)].node;
+	return list;
+}
+
+QAAdjacencyList QAPipeline::sinks() const
+{
+	QAAdjacencyList list;
+	for(int index: m_sinks) list << m_stages[size_t(index)].node;
+	return list;
+}
+
+bool QAPipeline::push(const QAPropertyMap& item, int msecs)
+{
+	QMutexLocker locker(&m_mutex);
+	QElapsedTimer timer;
+	timer.start();
+	forever
+	{
+		if(m_closed)
+		{
+			qWarning() << "QAPipeline: cannot push to a closed pipeline";
+			return false;
+		}
+		bool full = false;
+		for(int index: m_sources) full = full || m_stages[size_t(index)].items.size() >= m_capacity;
+		if(!full) break;
+		if(!waitFor(m_spaceCondition, &m_mutex, timer, msecs) && msecs >= 0) return false;
+	}
+	for(int index: m_sources) m_stages[size_t(index)].items.enqueue(item);
+	++m_pushed;
+	for(int index: m_sources) schedule(index);
+	return true;
+}
+
+bool QAPipeline::pop(QVector<QAPropertyMap>& results, int msecs)
+{
+	QMutexLocker locker(&m_mutex);
+	QElapsedTimer timer;
+	timer.start();
+	while(!resultAvailable())
+	{
+		if(m_closed && m_pushed == m_popped) return false;
+		if(!waitFor(m_resultCondition, &m_mutex, timer, msecs) && msecs >= 0) return false;
+	}
+	results.clear();
+	for(int index: m_sinks) results << m_stages[size_t(index)].results.dequeue();
+	++m_popped;
+	// The sinks may have been waiting for room
+	for(int index: m_sinks) schedule(index);
+	return true;
+}
+
+void QAPipeline::close()
+{
+	QMutexLocker locker(&m_mutex);
+	m_closed = true;
+	m_spaceCondition.wakeAll();
+	m_resultCondition.wakeAll();
+}
+
+bool QAPipeline::resultAvailable() const
+{
+	for(int index: m_sinks)
+	{
+		if(m_stages[size_t(index)].results.isEmpty()) return false;
+	}
+	return true;
+}
+
+bool QAPipeline::isReady(const Stage& stage) const
+{
+	if(stage.busy) return false;
+	// Every input must be available...
+	if(stage.inEdges.isEmpty() && stage.items.isEmpty()) return false;
+	for(int edge: stage.inEdges)
+	{
+		if(m_edges[edge].tokens.isEmpty()) return false;
+	}
+	// ...and there must be room for the outputs
+	if(stage.outEdges.isEmpty() && stage.results.size() >= m_capacity) return false;
+	for(int edge: stage.outEdges)
+	{
+		if(m_edges[edge].tokens.size() >= m_capacity) return false;
+	}
+	return true;
+}
+
+void QAPipeline::schedule(int index)
+{
+	// Called with m_mutex locked
+	Stage& stage = m_stages[size_t(index)];
+	if(m_stopping || !isReady(stage)) return;
+	stage.busy = true;
+	Firing firing;
+	firing.stage = index;
+	if(stage.inEdges.isEmpty())
+	{
+		firing.item = stage.items.dequeue();
+		m_spaceCondition.wakeAll();
+	}
+	firing.inputs.reserve(stage.inEdges.size());
+	for(int edge: stage.inEdges) firing.inputs << m_edges[edge].tokens.dequeue();
+	++m_activeTasks;
+	m_pool->start(new Task(this, m_pool, std::move(firing)));
+	// Ancestors may have been waiting for room in the queues just consumed
+	for(int edge: stage.inEdges) schedule(m_edges[edge].from);
+}
+
+void QAPipeline::fire(Firing& firing)
+{
+	Stage& stage = m_stages[size_t(firing.stage)];
+	QAlgorithm* node = stage.node.data();
+	const QMetaObject* nodeObj = node->metaObject();
+	// Load the inputs of this item
+	if(stage.inEdges.isEmpty())
+	{
+		node->setParameters(firing.item);
+	}
+	else
+	{
+		node->resetInputs();
+		for(int k = 0; k < stage.inEdges.size(); ++k)
+		{
+			const Edge& edge = m_edges[stage.inEdges[k]];
+			const QVector<QVariant>& token = firing.inputs[k];
+			const auto& bindings = edge.plan.bindings();
+			for(int i = 0; i < bindings.size(); ++i)
+			{
+				if(!nodeObj->property(bindings[i].second).write(node, token[i]))
+				{
+					qWarning() << "QAPipeline:" << nodeObj->property(bindings[i].second).name() << "failed to set for" << node->printName();
+				}
+			}
+		}
+	}
+	node->perform();
+	// Read the outputs to send downstream
+	QVector<QVector<QVariant>> tokens;
+	tokens.reserve(stage.outEdges.size());
+	for(int edge: stage.outEdges)
+	{
+		QVector<QVariant> token;
+		token.reserve(m_edges[edge].plan.bindings().size());
+		for(const auto& binding: m_edges[edge].plan.bindings()) token << nodeObj->property(binding.first).read(node);
+		tokens << token;
+	}
+	QAPropertyMap results;
+	if(stage.outEdges.isEmpty())
+	{
+		for(int k = 0; k < nodeObj->propertyCount(); ++k)
+		{
+			const QString name = nodeObj->property(k).name();
+			if(name.startsWith(QA_OUT)) results.insert(name.mid(int(strlen(QA_OUT))), nodeObj->property(k).read(node));
+			else if(name.startsWith(QA_PORT_OUT)) results.insert(name.mid(int(strlen(QA_PORT_OUT))), nodeObj->property(k).read(node));
+		}
+	}
+	bool notify = false;
+	{
+		QMutexLocker locker(&m_mutex);
+		for(int k = 0; k < stage.outEdges.size(); ++k) m_edges[stage.outEdges[k]].tokens.enqueue(std::move(tokens[k]));
+		if(stage.outEdges.isEmpty())
+		{
+			stage.results.enqueue(results);
+			notify = resultAvailable();
+			if(notify) m_resultCondition.wakeAll();
+		}
+		stage.busy = false;
+		// This stage may process the next item, and the descendants this one
+		schedule(firing.stage);
+		for(int edge: stage.outEdges) schedule(m_edges[edge].to);
+	}
+	if(notify) Q_EMIT resultReady();
+	// The destructor waits for this, so the pipeline must not be used afterwards
+	QMutexLocker locker(&m_mutex);
+	if(--m_activeTasks == 0) m_idleCondition.wakeAll();
+}
@@ -0,0 +1,214 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QAPipeline.h
+ *  Declarations for the QAPipeline class.
+ */
+
+#ifndef QAPipeline_h
+#define QAPipeline_h
+
+#include <QtCore>
+#include <vector>
+#include "QAlgorithm.h"
+#include "QABindingPlan.h"
+
+/**
+ * \brief Runs an algorithm graph on a continuous stream of items.
+ *
+ * The graph is built once, and each item pushed to the pipeline flows
+ * through it stage by stage: while an algorithm works on the k-th item, its
+ * ancestors may already work on the following ones, so that different items
+ * are in flight at different stages at the same time.
+ *
+ * Each connection of the graph becomes a bounded queue of the values that
+ * the ancestor sends to the descendant, resolved with QABindingPlan as in
+ * QAlgorithm::getInput(). An algorithm runs on its next item as soon as every
+ * incoming queue holds a value and every outgoing queue has room for a new
+ * one; each algorithm processes one item at a time, in the order the items
+ * have been pushed. When the queues are full, push() blocks until the
+ * stages downstream catch up (backpressure).
+ *
+ * Items enter the graph through its sources (the algorithms without
+ * ancestors): each source receives the whole map given to push(), with
+ * QAlgorithm::setParameters(). Results are taken from the sinks (the
+ * algorithms without descendants) with pop(), in the same order.
+ *
+ * \code
+ * QAPipeline pipeline(closer, 8);
+ * QtConcurrent::run([&]()
+ * {
+ * 	for(const auto& item: stream) pipeline.push({{"Item", item}});
+ * 	pipeline.close();
+ * });
+ * QVector<QAPropertyMap> results;
+ * while(pipeline.pop(results)) consume(results.first().value("Result"));
+ * \endcode
+ *
+ * \note Algorithms are reused for every item: their inputs are reset (see
+ * QAlgorithm::rearm()) before receiving the values of a new item, and their
+ * parameters are kept. A reimplementation of QAlgorithm::getInput() is not
+ * called, and typed port connections are not supported, since the values are
+ * transferred through the queues. While the pipeline exists, the algorithms
+ * must not be executed in any other way.
+ *
+ * \sa QAGraphExecutor
+ */
+class QAPipeline : public QObject
+{
+	Q_OBJECT
+
+	struct Edge
+	{
+		int from;
+		int to;
+		QABindingPlan plan;
+		QQueue<QVector<QVariant>> tokens;
+	};
+
+	struct Stage
+	{
+		QAShrAlgorithm node;
+		QVector<int> inEdges;
+		QVector<int> outEdges;
+		bool busy = false;
+		QQueue<QAPropertyMap> items;
+		QQueue<QAPropertyMap> results;
+	};
+
+	struct Firing
+	{
+		int stage;
+		QAPropertyMap item;
+		QVector<QVector<QVariant>> inputs;
+	};
+
+	std::vector<Stage> m_stages;
+	QVector<Edge> m_edges;
+	QVector<int> m_sources;
+	QVector<int> m_sinks;
+	const int m_capacity;
+
+	QThreadPool* m_pool;
+	mutable QMutex m_mutex;
+	QWaitCondition m_spaceCondition;
+	QWaitCondition m_resultCondition;
+	QWaitCondition m_idleCondition;
+	qint64 m_pushed = 0;
+	qint64 m_popped = 0;
+	int m_activeTasks = 0;
+	bool m_closed = false;
+	bool m_stopping = false;
+
+	class Task;
+
+	bool isReady(const Stage& stage) const;
+	bool resultAvailable() const;
+	void schedule(int index);
+	void fire(Firing& firing);
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * Takes the structure of the graph which \e node belongs to.
+	 *
+	 * \param[in] node Any algorithm of the graph.
+	 * \param[in] capacity Maximum number of items waiting on each connection,
+	 * and in front of each source and sink.
+	 * \param[in] parent Parent object.
+	 */
+	explicit QAPipeline(QAShrAlgorithm node, int capacity = 4, QObject* parent = Q_NULLPTR);
+
+	/**
+	 * \brief Destructor.
+	 *
+	 * Closes the pipeline and waits for the running stages to end;
+	 * items still in flight are discarded.
+	 */
+	~QAPipeline();
+
+	/** \brief Maximum number of items waiting on each connection. */
+	int capacity() const;
+
+	/**
+	 * \brief Run the stages on the given thread pool, instead of the global one.
+	 *
+	 * \param[in] pool The thread pool, or a null pointer to use the global one;
+	 * it is not owned and must outlive the pipeline.
+	 *
+	 * \sa QAThreadPool
+	 */
+	void setThreadPool(QThreadPool* pool);
+
+	/** \brief The thread pool the stages run on. */
+	QThreadPool* threadPool() const;
+
+	/** \brief Number of items pushed and not popped yet. */
+	int inFlight() const;
+
+	/**
+	 * \brief Feed a new item to the graph.
+	 *
+	 * Blocks while the queue in front of any source is full.
+	 *
+	 * \param[in] item Name-value pairs given to each source with QAlgorithm::setParameters().
+	 * \param[in] msecs Maximum waiting time in milliseconds, or -1 to wait forever.
+	 * \return Whether the item has been accepted, i.e. the pipeline is not
+	 * closed and there was room before the timeout.
+	 */
+	bool push(const QAPropertyMap& item, int msecs = -1);
+
+	/**
+	 * \brief Take the results of the oldest completed item.
+	 *
+	 * Blocks until every sink has processed the next item.
+	 *
+	 * \param[out] results The output properties of each sink, by base name,
+	 * in the same order as sinks().
+	 * \param[in] msecs Maximum waiting time in milliseconds, or -1 to wait forever.
+	 * \return Whether some results have been taken; false on timeout, or
+	 * when the pipeline has been closed and every item has been popped.
+	 */
+	bool pop(QVector<QAPropertyMap>& results, int msecs = -1);
+
+	/**
+	 * \brief Declare that no more items will be pushed.
+	 *
+	 * The items already pushed are still processed, and pop() returns false
+	 * once all of them have been taken.
+	 */
+	void close();
+
+	/** \brief The algorithms that receive the pushed items. */
+	QAAdjacencyList sources() const;
+
+	/** \brief The algorithms whose outputs are returned by pop(). */
+	QAAdjacencyList sinks() const;
+
+Q_SIGNALS:
+	/**
+	 * \brief Signal emitted when the results of an item are ready to be popped.
+	 *
+	 * \note The signal is emitted from a worker thread.
+	 */
+	Q_SIGNAL void resultReady();
+};
+
+#endif /* QAPipeline_h */
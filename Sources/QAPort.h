@@ -0,0 +1,210 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QAPort.h
+ *  Declarations for the typed port classes.
+ */
+
+#ifndef QAPort_h
+#define QAPort_h
+
+#include <QtCore>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+class QAlgorithm;
+
+/**
+ * \brief Type-independent part of an output port.
+ *
+ * Keeps track of how many input ports are connected to an output port,
+ * so that the payload can be moved to the last one served.
+ *
+ * \sa QAOutPort
+ */
+class QAOutPortBase
+{
+	QAtomicInt m_consumers;
+	QAtomicInt m_delivered;
+
+	friend class QAlgorithm;
+
+	/**
+	 * \brief Count a delivery to a consumer.
+	 *
+	 * \return Whether every consumer has been served, in which case
+	 * the count of deliveries starts again from zero.
+	 */
+	bool deliver()
+	{
+		if(m_delivered.fetchAndAddOrdered(1) + 1 < m_consumers.loadAcquire()) return false;
+		m_delivered.storeRelease(0);
+		return true;
+	}
+
+	/** \brief Drop the value and the deliveries counted so far. */
+	void clear()
+	{
+		m_delivered.storeRelease(0);
+		clearValue();
+	}
+
+protected:
+	/**
+	 * \brief Constructor.
+	 *
+	 * The port is recorded by \e owner, that clears it when it is recycled,
+	 * see QAlgorithm::recycle().
+	 *
+	 * \param[in] owner The algorithm the port belongs to.
+	 */
+	explicit QAOutPortBase(QAlgorithm* owner);
+
+	virtual ~QAOutPortBase() = default;
+
+	/** \brief Replace the value with a default-constructed one. */
+	virtual void clearValue() = 0;
+
+	Q_DISABLE_COPY(QAOutPortBase)
+
+public:
+	/** \brief Number of input ports connected to this output port. */
+	int consumerCount() const
+	{
+		return m_consumers.loadAcquire();
+	}
+};
+
+/**
+ * \brief Typed input port of an algorithm.
+ *
+ * A QAPort holds a value of type \e T that is written by a connected
+ * QAOutPort with a plain typed assignment, without going through QVariant.
+ * \e T may also be a move-only type, such as a buffer with unique ownership,
+ * in which case the port must be declared with QA_INPUT_MOVE_PORT().
+ * Ports are usually declared with the macro QA_INPUT_PORT(), and connected
+ * with QAlgorithm::setConnection(QSharedPointer<A>, QAOutPort<T> A::*, QSharedPointer<D>, QAPort<T> D::*),
+ * that checks at compile time that both ports hold the same type.
+ *
+ * \sa QAOutPort, QA_INPUT_PORT
+ */
+template<typename T>
+class QAPort
+{
+	T m_value;
+
+public:
+	/** \brief Type of the value held by the port. */
+	typedef T ValueType;
+
+	/** \brief Const reference to the value. */
+	const T& get() const
+	{
+		return m_value;
+	}
+
+	/** \brief Reference to the value. */
+	T& ref()
+	{
+		return m_value;
+	}
+
+	/** \brief Rvalue reference to the value, that can be moved away. */
+	T&& move()
+	{
+		return std::move(m_value);
+	}
+
+	/** \brief Copy the given value into the port. */
+	void set(const T& value)
+	{
+		m_value = value;
+	}
+
+	/** \brief Move the given value into the port. */
+	void set(T&& value)
+	{
+		m_value = std::move(value);
+	}
+};
+
+/**
+ * \brief Typed output port of an algorithm.
+ *
+ * Same as QAPort, with the bookkeeping of the connected consumers.
+ * Ports are usually declared with the macro QA_OUTPUT_PORT().
+ *
+ * \sa QAPort, QA_OUTPUT_PORT
+ */
+template<typename T>
+class QAOutPort : public QAOutPortBase, public QAPort<T>
+{
+protected:
+	void clearValue() override
+	{
+		this->set(T());
+	}
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] owner The algorithm the port belongs to.
+	 */
+	explicit QAOutPort(QAlgorithm* owner) : QAOutPortBase(owner)
+	{
+	}
+};
+
+/**
+ * \brief Typed connection between an output port and an input port.
+ *
+ * Links are stored by the descendant algorithm, and are triggered by
+ * QAlgorithm::getInput() when the \e source algorithm delivers its outputs.
+ */
+struct QAPortLink
+{
+	/** \brief The algorithm that owns the output port. */
+	const QAlgorithm* source;
+	/** \brief The output port. */
+	QAOutPortBase* output;
+	/** \brief Transfer function; its argument tells whether the value can be moved. */
+	std::function<void(bool)> transfer;
+	/** \brief Whether the value cannot be copied, thus it is moved regardless of \e KeepOutput. */
+	bool moveOnly = false;
+
+	/** \brief Assign the value of \e out to \e in, copying it unless \e release is set. */
+	template<typename T>
+	static void assign(QAOutPort<T>* out, QAPort<T>* in, bool release, std::true_type /*copyable*/)
+	{
+		if(release) in->set(out->move());
+		else in->set(out->get());
+	}
+
+	/** \brief Move the value of \e out to \e in; a move-only value cannot be shared among consumers. */
+	template<typename T>
+	static void assign(QAOutPort<T>* out, QAPort<T>* in, bool release, std::false_type /*copyable*/)
+	{
+		if(release) in->set(out->move());
+		else qWarning() << "QAPortLink: a move-only value can only be delivered to its last consumer";
+	}
+};
+
+#endif /* QAPort_h */
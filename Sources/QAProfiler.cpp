@@ -0,0 +1,396 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include "QAProfiler.h"
+#include <algorithm>
+
+namespace
+{
+	// Each profiler gets a unique identifier, so that a thread never uses
+	// the cached buffer of a profiler that has been destroyed
+	QAtomicInteger<quint64> profilerCounter;
+
+	struct QAThreadCache
+	{
+		quint64 profiler = 0;
+		void* buffer = Q_NULLPTR;
+	};
+
+	thread_local QAThreadCache threadCache;
+
+	QString nodeName(const char* className, const QAlgorithm* node)
+	{
+		return QString("%1 0x%2").arg(className).arg(quintptr(node), 0, 16);
+	}
+
+	QString micro(qint64 nsecs)
+	{
+		return QString::number(double(nsecs) / 1000.0, 'f', 1) + " us";
+	}
+}
+
+QAProfiler::QAProfiler() : m_id(profilerCounter.fetchAndAddOrdered(1) + 1)
+{
+	m_clock.start();
+}
+
+QAProfiler::~QAProfiler()
+{
+	qDeleteAll(m_buffers);
+}
+
+void QAProfiler::attach(const QAShrAlgorithm& node, QAProfiler* profiler)
+{
+	const QAGraphSnapshot graph(node);
+	for(const auto& algorithm: graph.nodes()) algorithm->setProfiler(profiler);
+}
+
+qint64 QAProfiler::now() const
+{
+	return m_clock.nsecsElapsed();
+}
+
+QAProfiler::Buffer* QAProfiler::localBuffer()
+{
+	if(threadCache.profiler == m_id) return static_cast<Buffer*>(threadCache.buffer);
+	Qt::HANDLE thread = QThread::currentThreadId();
+	QMutexLocker locker(&m_lock);
+	auto it = std::find_if(m_buffers.begin(), m_buffers.end(), [thread](const Buffer* buffer)
+						   {return buffer->owner == thread;}
+						   );
+	Buffer* buffer;
+	if(it != m_buffers.end()) buffer = *it;
+	else
+	{
+		buffer = new Buffer;
+		buffer->owner = thread;
+		buffer->thread = m_buffers.size();
+		m_buffers << buffer;
+	}
+	threadCache.profiler = m_id;
+	threadCache.buffer = buffer;
+	return buffer;
+}
+
+void QAProfiler::record(Event event, const QAlgorithm* node, qint64 begin, qint64 end, const QAlgorithm* peer)
+{
+	Buffer* buffer = localBuffer();
+	Record record;
+	record.event = event;
+	record.node = node;
+	record.className = node->metaObject()->className();
+	record.peer = peer;
+	record.begin = begin;
+	record.end = end;
+	record.thread = buffer->thread;
+	// The lock is only contended while someone is reading the records
+	QMutexLocker locker(&buffer->lock);
+	buffer->records << record;
+}
+
+QVector<QAProfiler::Record> QAProfiler::records() const
+{
+	QVector<Record> all;
+	QMutexLocker locker(&m_lock);
+	for(const Buffer* buffer: m_buffers)
+	{
+		QMutexLocker bufferLocker(&buffer->lock);
+		all += buffer->records;
+	}
+	locker.unlock();
+	std::stable_sort(all.begin(), all.end(), [](const Record& a, const Record& b)
+					 {return a.begin < b.begin;}
+					 );
+	return all;
+}
+
+int QAProfiler::threadCount() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_buffers.size();
+}
+
+void QAProfiler::clear()
+{
+	QMutexLocker locker(&m_lock);
+	for(Buffer* buffer: m_buffers)
+	{
+		QMutexLocker bufferLocker(&buffer->lock);
+		buffer->records.clear();
+	}
+}
+
+QString QAProfiler::summary(const QAGraphSnapshot& graph, int slowestEdges) const
+{
+	struct NodeTimes
+	{
+		const char* className = "";
+		qint64 queue = 0;
+		qint64 run = 0;
+		qint64 input = 0;
+		qint64 propagation = 0;
+	};
+	typedef QPair<const QAlgorithm*, const QAlgorithm*> Edge;
+
+	const auto all = records();
+	QString report;
+	QTextStream out(&report);
+	if(all.isEmpty())
+	{
+		out << "QAProfiler: no event recorded\n";
+		return report;
+	}
+	// Aggregate the events by node and by edge
+	QHash<const QAlgorithm*, NodeTimes> nodes;
+	QHash<Edge, qint64> edges;
+	QVector<Record> inputs;
+	QSet<int> threads;
+	qint64 first = all.first().begin, last = all.first().end, busy = 0;
+	for(const Record& record: all)
+	{
+		first = qMin(first, record.begin);
+		last = qMax(last, record.end);
+		NodeTimes& times = nodes[record.node];
+		times.className = record.className;
+		const qint64 duration = record.end - record.begin;
+		switch(record.event)
+		{
+			case Queue:
+				times.queue += duration;
+				break;
+			case Run:
+				times.run += duration;
+				busy += duration;
+				threads << record.thread;
+				break;
+			case Input:
+				times.input += duration;
+				edges[Edge(record.peer, record.node)] += duration;
+				inputs << record;
+				break;
+			case Propagation:
+				times.propagation += duration;
+				break;
+		}
+	}
+	const qint64 wall = last - first;
+	const int threadsUsed = qMax(1, threads.size());
+	out << "QAProfiler summary\n";
+	out << "  wall time: " << micro(wall) << ", threads: " << threadsUsed
+		<< ", time in run(): " << micro(busy) << ", parallel efficiency: "
+		<< QString::number(wall > 0 ? 100.0 * busy / (double(wall) * threadsUsed) : 100.0, 'f', 1) << " %\n";
+	// Timings of each node, slowest first
+	QVector<const QAlgorithm*> order = nodes.keys().toVector();
+	std::sort(order.begin(), order.end(), [&nodes](const QAlgorithm* a, const QAlgorithm* b)
+			  {return nodes[a].run > nodes[b].run;}
+			  );
+	out << "  nodes (queue / run / input / propagation):\n";
+	for(const QAlgorithm* node: order)
+	{
+		const NodeTimes& times = nodes[node];
+		out << "    " << nodeName(times.className, node) << ": " << micro(times.queue) << " / "
+			<< micro(times.run) << " / " << micro(times.input) << " / " << micro(times.propagation) << "\n";
+	}
+	// Build the graph, either from the given representation or from the recorded edges
+	QHash<const QAlgorithm*, QVector<const QAlgorithm*>> children;
+	QHash<const QAlgorithm*, int> inDegree;
+	for(const QAlgorithm* node: order) inDegree[node] = 0;
+	if(!graph.isEmpty())
+	{
+		for(int k = 0; k < graph.size(); ++k)
+		{
+			inDegree[graph.node(k).data()] += 0;
+			for(int child: graph.descendants(k))
+			{
+				children[graph.node(k).data()] << graph.node(child).data();
+				inDegree[graph.node(child).data()] += 1;
+			}
+		}
+	}
+	else
+	{
+		for(auto it = edges.cbegin(); it != edges.cend(); ++it)
+		{
+			children[it.key().first] << it.key().second;
+			inDegree[it.key().first] += 0;
+			inDegree[it.key().second] += 1;
+		}
+	}
+	// Longest path in topological order, weighting nodes by run() and edges by getInput()
+	QHash<const QAlgorithm*, qint64> distance;
+	QHash<const QAlgorithm*, const QAlgorithm*> predecessor;
+	QQueue<const QAlgorithm*> ready;
+	for(auto it = inDegree.cbegin(); it != inDegree.cend(); ++it)
+	{
+		if(it.value() == 0)
+		{
+			ready.enqueue(it.key());
+			distance[it.key()] = nodes.value(it.key()).run;
+		}
+	}
+	const QAlgorithm* end = Q_NULLPTR;
+	while(!ready.isEmpty())
+	{
+		const QAlgorithm* node = ready.dequeue();
+		if(end == Q_NULLPTR || distance[node] > distance[end]) end = node;
+		for(const QAlgorithm* child: children.value(node))
+		{
+			const qint64 candidate = distance[node] + edges.value(Edge(node, child)) + nodes.value(child).run;
+			if(!distance.contains(child) || candidate > distance[child])
+			{
+				distance[child] = candidate;
+				predecessor[child] = node;
+			}
+			if(--inDegree[child] == 0) ready.enqueue(child);
+		}
+	}
+	if(end != Q_NULLPTR)
+	{
+		QStringList path;
+		for(const QAlgorithm* node = end; node != Q_NULLPTR; node = predecessor.value(node, Q_NULLPTR))
+		{
+			path.prepend(nodeName(nodes.value(node).className, node));
+		}
+		out << "  critical path (" << micro(distance[end]) << "):\n    " << path.join("\n    -> ") << "\n";
+	}
+	// Slowest edges
+	std::sort(inputs.begin(), inputs.end(), [](const Record& a, const Record& b)
+			  {return a.end - a.begin > b.end - b.begin;}
+			  );
+	if(inputs.size() > slowestEdges) inputs.resize(qMax(0, slowestEdges));
+	if(!inputs.isEmpty())
+	{
+		out << "  slowest edges:\n";
+		for(const Record& record: inputs)
+		{
+			out << "    " << nodeName(nodes.value(record.peer).className, record.peer) << " -> "
+				<< nodeName(record.className, record.node) << ": " << micro(record.end - record.begin) << "\n";
+		}
+	}
+	return report;
+}
+
+bool QAProfiler::writeChromeTrace(const QString& path) const
+{
+	const auto all = records();
+	// Timestamps are expressed in microseconds
+	auto micros = [](qint64 nsecs){return double(nsecs) / 1000.0;};
+	QJsonArray events;
+	QSet<int> threads;
+	// Algorithms may run many times, thus runs are keyed by (algorithm, run index);
+	// since records are sorted by begin, the inputs of a run come after the previous run
+	typedef QPair<const QAlgorithm*, int> RunKey;
+	QHash<RunKey, const Record*> runs;
+	QHash<const QAlgorithm*, int> runCounts;
+	QVector<QPair<RunKey, RunKey>> edges;
+	for(const Record& record: all)
+	{
+		threads << record.thread;
+		if(record.event == Input)
+		{
+			edges << qMakePair(RunKey(record.peer, runCounts.value(record.peer) - 1), RunKey(record.node, runCounts.value(record.node)));
+		}
+		if(record.event == Queue) continue;
+		QJsonObject event;
+		QJsonObject args;
+		args["node"] = nodeName(record.className, record.node);
+		switch(record.event)
+		{
+			case Run:
+				event["name"] = record.className;
+				event["cat"] = "run";
+				runs.insert(RunKey(record.node, runCounts[record.node]++), &record);
+				break;
+			case Input:
+				event["name"] = QString("getInput ") + record.className;
+				event["cat"] = "input";
+				// The ancestor may be gone already, only its address is reported
+				args["ancestor"] = QString("0x%1").arg(quintptr(record.peer), 0, 16);
+				break;
+			case Propagation:
+				event["name"] = QString("propagate ") + record.className;
+				event["cat"] = "propagation";
+				break;
+			case Queue:
+				break;
+		}
+		event["ph"] = "X";
+		event["pid"] = 1;
+		event["tid"] = record.thread;
+		event["ts"] = micros(record.begin);
+		event["dur"] = micros(record.end - record.begin);
+		event["args"] = args;
+		events.append(event);
+	}
+	// One named lane for each thread
+	for(int thread: threads)
+	{
+		QJsonObject event;
+		event["name"] = "thread_name";
+		event["ph"] = "M";
+		event["pid"] = 1;
+		event["tid"] = thread;
+		event["args"] = QJsonObject{{"name", QString("worker %1").arg(thread)}};
+		events.append(event);
+	}
+	// Flow arrows from the ancestor's run() to the descendant's run()
+	int flow = 0;
+	for(const auto& edge: edges)
+	{
+		const Record* from = runs.value(edge.first, Q_NULLPTR);
+		const Record* to = runs.value(edge.second, Q_NULLPTR);
+		if(from == Q_NULLPTR || to == Q_NULLPTR) continue;
+		++flow;
+		QJsonObject start;
+		start["name"] = "edge";
+		start["cat"] = "edge";
+		start["ph"] = "s";
+		start["id"] = flow;
+		start["pid"] = 1;
+		start["tid"] = from->thread;
+		start["ts"] = micros(from->end) - 0.001;
+		events.append(start);
+		QJsonObject finish;
+		finish["name"] = "edge";
+		finish["cat"] = "edge";
+		finish["ph"] = "f";
+		finish["bp"] = "e";
+		finish["id"] = flow;
+		finish["pid"] = 1;
+		finish["tid"] = to->thread;
+		finish["ts"] = micros(to->begin);
+		events.append(finish);
+	}
+	QJsonObject trace;
+	trace["traceEvents"] = events;
+	trace["displayTimeUnit"] = "ns";
+	QFile file(path);
+	if(!file.open(QFile::WriteOnly))
+	{
+		qWarning() << "QAProfiler: cannot write the trace to" << path;
+		return false;
+	}
+	const QByteArray json = QJsonDocument(trace).toJson(QJsonDocument::Compact);
+	if(file.write(json) != json.size())
+	{
+		qWarning() << "QAProfiler: cannot write the trace to" << path << file.errorString();
+		return false;
+	}
+	return true;
+}
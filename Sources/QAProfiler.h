@@ -0,0 +1,169 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QAProfiler.h
+ *  Declarations for the QAProfiler class.
+ */
+
+#ifndef QAProfiler_h
+#define QAProfiler_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+#include "QAGraphSnapshot.h"
+
+/**
+ * \brief Records the timings of the algorithms of a graph.
+ *
+ * Once attached to the algorithms of a graph (see attach() or
+ * QAlgorithm::setProfiler()), the profiler records, for every algorithm:
+ * - the time spent waiting in the thread pool queue, from the moment it is
+ * ready to the moment it starts;
+ * - the duration of its run() function;
+ * - the time spent receiving the inputs from each ancestor, through QAlgorithm::getInput();
+ * - the time spent propagating the execution to its descendants.
+ *
+ * Times are measured with a monotonic clock, in nanoseconds since the creation
+ * of the profiler, and each thread writes to its own buffer, so that recording
+ * does not serialize the workers. The recorded events can be retrieved with
+ * records(), or summarized by summary(), that reports the critical path of the
+ * graph, the parallel efficiency and the slowest edges.
+ *
+ * \note Nodes are identified by their address; the records do not keep them alive.
+ *
+ * \sa QAlgorithm::setProfiler, QAGraphExecutor::setProfiler
+ */
+class QAProfiler
+{
+public:
+	/** \brief Kind of recorded event. */
+	enum Event
+	{
+		Queue,			///< Time between being ready and starting to run.
+		Run,			///< Duration of run().
+		Input,			///< Duration of getInput(); the peer is the ancestor.
+		Propagation		///< Time spent serving the descendants after run().
+	};
+
+	/** \brief A single recorded event. */
+	struct Record
+	{
+		/** \brief Kind of event. */
+		Event event;
+		/** \brief Algorithm the event refers to. */
+		const QAlgorithm* node;
+		/** \brief Class name of the algorithm. */
+		const char* className;
+		/** \brief Other algorithm involved, i.e. the ancestor for Input events. */
+		const QAlgorithm* peer;
+		/** \brief Begin of the event, in nanoseconds. */
+		qint64 begin;
+		/** \brief End of the event, in nanoseconds. */
+		qint64 end;
+		/** \brief Index of the thread that recorded the event. */
+		int thread;
+	};
+
+	/** \brief Constructor, the clock starts here. */
+	QAProfiler();
+
+	/** \brief Destructor. */
+	~QAProfiler();
+
+	/**
+	 * \brief Attach a profiler to each algorithm of a graph.
+	 *
+	 * \param[in] node Any algorithm of the graph.
+	 * \param[in] profiler The profiler to attach, or a null pointer to detach.
+	 */
+	static void attach(const QAShrAlgorithm& node, QAProfiler* profiler);
+
+	/** \brief Nanoseconds elapsed since the profiler creation. */
+	qint64 now() const;
+
+	/**
+	 * \brief Record an event in the buffer of the calling thread.
+	 *
+	 * \param[in] event Kind of event.
+	 * \param[in] node Algorithm the event refers to.
+	 * \param[in] begin Begin of the event, as returned by now().
+	 * \param[in] end End of the event, as returned by now().
+	 * \param[in] peer Other algorithm involved, if any.
+	 */
+	void record(Event event, const QAlgorithm* node, qint64 begin, qint64 end, const QAlgorithm* peer = Q_NULLPTR);
+
+	/** \brief All the events recorded so far, from every thread, sorted by begin time. */
+	QVector<Record> records() const;
+
+	/** \brief Number of threads that recorded at least one event. */
+	int threadCount() const;
+
+	/** \brief Discard every recorded event. */
+	void clear();
+
+	/**
+	 * \brief Summarize the recorded events.
+	 *
+	 * The summary contains the wall time, the parallel efficiency (time spent
+	 * in run() over wall time times the number of threads), the timings of
+	 * each algorithm, the critical path and the slowest edges.
+	 *
+	 * The critical path is the path of the graph with the highest sum of
+	 * run() and getInput() times; it is computed on \e graph if given,
+	 * otherwise on the edges seen in the Input events.
+	 *
+	 * \param[in] graph Snapshot of the profiled graph, see QAlgorithm::snapshot().
+	 * \param[in] slowestEdges Number of slowest edges to report.
+	 * \return A human-readable report.
+	 */
+	QString summary(const QAGraphSnapshot& graph = QAGraphSnapshot(), int slowestEdges = 10) const;
+	
+	/**
+	 * \brief Write the recorded events in the Chrome Trace Event Format.
+	 *
+	 * The generated JSON file can be opened with chrome://tracing or with
+	 * the Perfetto UI (https://ui.perfetto.dev). It contains one lane for each
+	 * thread, one slice for each run(), getInput() and propagation, and a flow
+	 * arrow for each edge from an ancestor's run() to its descendant's run();
+	 * when algorithms run many times, each arrow joins the runs of the same
+	 * execution.
+	 *
+	 * \param[in] path Path of the output file.
+	 * \return Whether the file has been written successfully.
+	 */
+	bool writeChromeTrace(const QString& path) const;
+
+private:
+	struct Buffer
+	{
+		Qt::HANDLE owner;
+		int thread;
+		mutable QMutex lock;
+		QVector<Record> records;
+	};
+
+	Buffer* localBuffer();
+
+	const quint64 m_id;
+	QElapsedTimer m_clock;
+	mutable QMutex m_lock;
+	QVector<Buffer*> m_buffers;
+};
+
+#endif /* QAProfiler_h */
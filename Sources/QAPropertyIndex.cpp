@@ -0,0 +1,105 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QAPropertyIndex.h"
+#include "qa_macros.h"
+
+namespace
+{
+	QReadWriteLock& cacheLock()
+	{
+		static QReadWriteLock lock;
+		return lock;
+	}
+
+	QHash<const QMetaObject*, QAPropertyIndex>& cache()
+	{
+		static QHash<const QMetaObject*, QAPropertyIndex> indices;
+		return indices;
+	}
+}
+
+QAParameterHandle::QAParameterHandle(const QMetaObject* metaObject, const QString& name, const QVector<int>& properties) :
+m_metaObject(metaObject), m_name(name), m_properties(properties)
+{
+}
+
+bool QAParameterHandle::isValid() const
+{
+	return m_metaObject != Q_NULLPTR && !m_properties.isEmpty();
+}
+
+const QMetaObject* QAParameterHandle::metaObject() const
+{
+	return m_metaObject;
+}
+
+const QString& QAParameterHandle::name() const
+{
+	return m_name;
+}
+
+const QVector<int>& QAParameterHandle::properties() const
+{
+	return m_properties;
+}
+
+QAPropertyIndex QAPropertyIndex::of(const QMetaObject* metaObject)
+{
+	{
+		QReadLocker locker(&cacheLock());
+		auto it = cache().constFind(metaObject);
+		if(it != cache().constEnd()) return it.value();
+	}
+	auto index = build(metaObject);
+	QWriteLocker locker(&cacheLock());
+	cache().insert(metaObject, index);
+	return index;
+}
+
+QAPropertyIndex QAPropertyIndex::build(const QMetaObject* metaObject)
+{
+	QAPropertyIndex index;
+	index.m_metaObject = metaObject;
+	for(int k = 0; k < metaObject->propertyCount(); ++k)
+	{
+		const char* name = metaObject->property(k).name();
+		// Parameters, inputs and input ports can be set by their base name
+		for(const char* prefix: {QA_PAR, QA_IN, QA_PORT_IN})
+		{
+			if(qstrncmp(name, prefix, qstrlen(prefix)) == 0)
+			{
+				index.m_settable[QString::fromLatin1(name + qstrlen(prefix))] << k;
+				break;
+			}
+		}
+	}
+	return index;
+}
+
+QVector<int> QAPropertyIndex::settable(const QString& name) const
+{
+	return m_settable.value(name);
+}
+
+QAParameterHandle QAPropertyIndex::handle(const QString& name) const
+{
+	return QAParameterHandle(m_metaObject, name, settable(name));
+}
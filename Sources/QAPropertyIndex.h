@@ -0,0 +1,130 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QAPropertyIndex.h
+ *  Declarations for the QAPropertyIndex and QAParameterHandle classes.
+ */
+
+#ifndef QAPropertyIndex_h
+#define QAPropertyIndex_h
+
+#include <QtCore>
+
+/**
+ * \brief Pre-resolved reference to a parameter or input of an algorithm class.
+ *
+ * A handle stores the indices of the properties that QAlgorithm::setParameters()
+ * would write for a given name, so that the name is looked up only once.
+ * It is obtained from QAlgorithm::parameterHandle() and can be used with
+ * QAlgorithm::setParameter() on any instance of the same class.
+ *
+ * \code
+ * const QAParameterHandle threshold = filter->parameterHandle("Threshold");
+ * for(const auto& value: values)
+ * {
+ * 	filter->setParameter(threshold, value);
+ * 	...
+ * }
+ * \endcode
+ *
+ * \sa QAPropertyIndex
+ */
+class QAParameterHandle
+{
+public:
+	/** \brief Constructs an invalid handle. */
+	QAParameterHandle() = default;
+
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] metaObject The class the handle has been resolved for.
+	 * \param[in] name The base name of the parameter.
+	 * \param[in] properties The indices of the matching properties.
+	 */
+	QAParameterHandle(const QMetaObject* metaObject, const QString& name, const QVector<int>& properties);
+
+	/** \brief Whether the handle refers to at least one property. */
+	bool isValid() const;
+
+	/** \brief The class the handle has been resolved for. */
+	const QMetaObject* metaObject() const;
+
+	/** \brief The base name of the parameter. */
+	const QString& name() const;
+
+	/** \brief The indices of the matching properties, as in the meta-object. */
+	const QVector<int>& properties() const;
+
+private:
+	const QMetaObject* m_metaObject = Q_NULLPTR;
+	QString m_name;
+	QVector<int> m_properties;
+};
+
+/**
+ * \brief Per-class index of the properties that can be set by name.
+ *
+ * For each algorithm class, maps the base name of every parameter, input and
+ * input port to the indices of the corresponding properties, e.g. both
+ * \e par_Name and \e algin_Name are found under \e Name. The index is built
+ * by scanning the meta-object the first time a class is looked up, then it is
+ * kept in a global cache shared by every instance, so that setting a parameter
+ * by name costs a single hash lookup.
+ *
+ * \sa QAlgorithm::setParameters, QAParameterHandle
+ */
+class QAPropertyIndex
+{
+public:
+	/**
+	 * \brief Get the index of the given class.
+	 *
+	 * The index is looked up in the global cache, and it is built and
+	 * inserted in the cache if not found. This function is thread-safe.
+	 *
+	 * \param[in] metaObject The class to be indexed.
+	 * \return The property index of the class.
+	 */
+	static QAPropertyIndex of(const QMetaObject* metaObject);
+
+	/**
+	 * \brief Indices of the properties settable with the given base name.
+	 *
+	 * \return The property indices, or an empty vector if nothing matches.
+	 */
+	QVector<int> settable(const QString& name) const;
+
+	/**
+	 * \brief Resolve a handle for the given base name.
+	 *
+	 * \return A handle, that is invalid if nothing matches.
+	 */
+	QAParameterHandle handle(const QString& name) const;
+
+private:
+	/** \brief Scan the meta-object to build the index. */
+	static QAPropertyIndex build(const QMetaObject* metaObject);
+
+	const QMetaObject* m_metaObject = Q_NULLPTR;
+	QHash<QString, QVector<int>> m_settable;
+};
+
+#endif /* QAPropertyIndex_h */
@@ -0,0 +1,253 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+#include "QAResultCache.h"
+#include "QAGraphSnapshot.h"
+
+namespace
+{
+	// Properties of QAlgorithm itself do not affect the results
+	bool isKeyProperty(const QMetaProperty& prop)
+	{
+		if(prop.propertyIndex() < QAlgorithm::staticMetaObject.propertyCount()) return false;
+		for(const char* prefix: {QA_PAR, QA_IN, QA_IN_LIST, QA_PORT_IN})
+		{
+			if(qstrncmp(prop.name(), prefix, qstrlen(prefix)) == 0) return true;
+		}
+		return false;
+	}
+
+	// Input lists and vectors are hashed element by element, in the order they were received
+	bool saveValue(QDataStream& stream, const QMetaProperty& prop, const QVariant& value)
+	{
+		if(!value.isValid()) return true;
+		if(qstrncmp(prop.name(), QA_IN_LIST, qstrlen(QA_IN_LIST)) != 0)
+		{
+			return QMetaType::save(stream, value.userType(), value.constData());
+		}
+		if(!value.canConvert<QVariantList>()) return false;
+		const QSequentialIterable values = value.value<QSequentialIterable>();
+		stream << quint32(values.size());
+		for(const QVariant& element: values)
+		{
+			if(!QMetaType::save(stream, element.userType(), element.constData())) return false;
+		}
+		return true;
+	}
+
+	bool isOutputProperty(const QMetaProperty& prop)
+	{
+		return qstrncmp(prop.name(), QA_OUT, qstrlen(QA_OUT)) == 0 ||
+		qstrncmp(prop.name(), QA_PORT_OUT, qstrlen(QA_PORT_OUT)) == 0;
+	}
+}
+
+QAResultCache::QAResultCache(int maxEntries) : m_memory(maxEntries)
+{
+}
+
+void QAResultCache::attach(const QAShrAlgorithm& node, QAResultCache* cache)
+{
+	const QAGraphSnapshot graph(node);
+	for(const auto& current: graph.nodes()) current->setResultCache(cache);
+}
+
+void QAResultCache::setMaxEntries(int maxEntries)
+{
+	QMutexLocker locker(&m_lock);
+	m_memory.setMaxCost(maxEntries);
+}
+
+int QAResultCache::maxEntries() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_memory.maxCost();
+}
+
+void QAResultCache::setDirectory(const QString& directory)
+{
+	if(!directory.isEmpty() && !QDir().mkpath(directory))
+	{
+		qWarning() << "QAResultCache: cannot create" << directory;
+		return;
+	}
+	QMutexLocker locker(&m_lock);
+	m_directory = directory;
+}
+
+QString QAResultCache::directory() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_directory;
+}
+
+void QAResultCache::clear()
+{
+	QMutexLocker locker(&m_lock);
+	m_memory.clear();
+}
+
+qint64 QAResultCache::hits() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_hits;
+}
+
+qint64 QAResultCache::misses() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_misses;
+}
+
+QByteArray QAResultCache::keyOf(const QAlgorithm* node)
+{
+	const QMetaObject* metaObject = node->metaObject();
+	// Move-only ports have no property, thus they can be neither hashed nor restored
+	for(int k = 0; k < metaObject->classInfoCount(); ++k)
+	{
+		if(qstrcmp(metaObject->classInfo(k).value(), QA_MOVE_PORT) == 0) return QByteArray();
+	}
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	QByteArray buffer;
+	for(int k = 0; k < metaObject->propertyCount(); ++k)
+	{
+		const QMetaProperty prop = metaObject->property(k);
+		if(!isKeyProperty(prop)) continue;
+		const QVariant value = prop.read(node);
+		// Each value is preceded by its ordinal, so that values cannot be confused
+		buffer.clear();
+		QDataStream stream(&buffer, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_6);
+		stream << quint32(k) << quint8(value.isValid());
+		if(!saveValue(stream, prop, value)) return QByteArray();
+		hash.addData(buffer);
+	}
+	return QByteArray(metaObject->className()) + '/' + hash.result().toHex();
+}
+
+bool QAResultCache::restore(const QByteArray& key, QAlgorithm* node)
+{
+	const QMetaObject* metaObject = node->metaObject();
+	Outputs outputs;
+	bool found = false;
+	QString directory;
+	{
+		QMutexLocker locker(&m_lock);
+		if(Outputs* cached = m_memory.object(key))
+		{
+			outputs = *cached;
+			found = true;
+		}
+		directory = m_directory;
+	}
+	if(!found && !directory.isEmpty() && load(key, metaObject, outputs))
+	{
+		// Promote the result to the memory tier
+		found = true;
+		QMutexLocker locker(&m_lock);
+		m_memory.insert(key, new Outputs(outputs));
+	}
+	{
+		QMutexLocker locker(&m_lock);
+		if(found) ++m_hits;
+		else ++m_misses;
+	}
+	if(!found) return false;
+	for(const auto& output: outputs)
+	{
+		if(!metaObject->property(output.first).write(node, output.second))
+		{
+			qWarning() << "QAResultCache:" << metaObject->property(output.first).name() << "failed to set for" << node->printName();
+			return false;
+		}
+	}
+	return true;
+}
+
+void QAResultCache::insert(const QByteArray& key, const QAlgorithm* node)
+{
+	const QMetaObject* metaObject = node->metaObject();
+	Outputs outputs;
+	for(int k = 0; k < metaObject->propertyCount(); ++k)
+	{
+		const QMetaProperty prop = metaObject->property(k);
+		if(isOutputProperty(prop)) outputs << qMakePair(k, prop.read(node));
+	}
+	QString directory;
+	{
+		QMutexLocker locker(&m_lock);
+		m_memory.insert(key, new Outputs(outputs));
+		directory = m_directory;
+	}
+	if(!directory.isEmpty()) store(key, metaObject, outputs);
+}
+
+QString QAResultCache::filePath(const QByteArray& key) const
+{
+	// The class name may contain characters not allowed in file names
+	return QDir(directory()).filePath(QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()));
+}
+
+bool QAResultCache::load(const QByteArray& key, const QMetaObject* metaObject, Outputs& outputs) const
+{
+	QFile file(filePath(key));
+	if(!file.open(QIODevice::ReadOnly)) return false;
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_6);
+	QByteArray storedKey;
+	QAPropertyMap values;
+	stream >> storedKey >> values;
+	if(stream.status() != QDataStream::Ok || storedKey != key) return false;
+	// Outputs are stored by name, since property indices may change across builds
+	outputs.clear();
+	for(auto it = values.cbegin(); it != values.cend(); ++it)
+	{
+		const int index = metaObject->indexOfProperty(it.key().toLatin1().constData());
+		if(index < 0) return false;
+		outputs << qMakePair(index, it.value());
+	}
+	return true;
+}
+
+void QAResultCache::store(const QByteArray& key, const QMetaObject* metaObject, const Outputs& outputs) const
+{
+	QAPropertyMap values;
+	for(const auto& output: outputs)
+	{
+		// Streaming a QVariant of a type without stream operators would write a corrupted entry
+		const QVariant& value = output.second;
+		QByteArray scratch;
+		QDataStream check(&scratch, QIODevice::WriteOnly);
+		check.setVersion(QDataStream::Qt_5_6);
+		if(value.isValid() && !QMetaType::save(check, value.userType(), value.constData())) return;
+		values.insert(metaObject->property(output.first).name(), value);
+	}
+	QSaveFile file(filePath(key));
+	if(!file.open(QIODevice::WriteOnly)) return;
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_6);
+	stream << key << values;
+	if(stream.status() == QDataStream::Ok) file.commit();
+	else
+	{
+		qWarning() << "QAResultCache: cannot save the result of" << metaObject->className();
+		file.cancelWriting();
+	}
+}
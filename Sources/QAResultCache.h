@@ -0,0 +1,154 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+
+/** \file QAResultCache.h
+ *  Declarations for the QAResultCache class.
+ */
+
+#ifndef QAResultCache_h
+#define QAResultCache_h
+
+#include <QtCore>
+#include "QAlgorithm.h"
+
+/**
+ * \brief Memoization of the results of algorithms.
+ *
+ * Once attached to an algorithm (see attach() or QAlgorithm::setResultCache()),
+ * the cache is looked up before each run(): if an instance of the same class
+ * already ran with the same parameters and inputs, run() is skipped and the
+ * outputs are restored from the cache; otherwise, the outputs are stored
+ * in the cache after run().
+ *
+ * The key of a result is made of the class name and of a SHA-1 hash of the
+ * values of the parameters, inputs and input ports declared by the class and
+ * its ancestors, excluding those of QAlgorithm itself, that do not affect the
+ * results. Input lists and vectors (see QA_INPUT_LIST() and QA_INPUT_VEC())
+ * are hashed as a whole, in the order their values were received: since
+ * the order of the ancestors finishing is not deterministic in parallel
+ * executions, the same values received in another order are a miss, never
+ * a wrong hit. Values are hashed through their QDataStream operators, thus
+ * algorithms with inputs or parameters of types without stream operators are
+ * never cached, nor are algorithms with move-only ports (see
+ * QA_INPUT_MOVE_PORT() and QA_OUTPUT_MOVE_PORT()), whose values have no
+ * property and could be neither hashed nor restored. Results with outputs
+ * of types without stream operators are kept in memory only.
+ *
+ * Results are kept in memory up to a maximum number, evicting the least
+ * recently used; if a directory is given, results are also written there,
+ * and looked up when they are not in memory, so that they survive the process.
+ *
+ * \code
+ * QAResultCache cache(1000);
+ * cache.setDirectory(QDir::temp().filePath("results"));
+ * QAResultCache::attach(closer, &cache);
+ * \endcode
+ *
+ * \note Only deterministic algorithms, whose outputs only depend on their
+ * parameters and inputs, should be cached.
+ *
+ * \sa QAlgorithm::setResultCache
+ */
+class QAResultCache
+{
+	/** \brief Output values by property index. */
+	typedef QVector<QPair<int, QVariant>> Outputs;
+
+	mutable QMutex m_lock;
+	QCache<QByteArray, Outputs> m_memory;
+	QString m_directory;
+	qint64 m_hits = 0;
+	qint64 m_misses = 0;
+
+	Q_DISABLE_COPY(QAResultCache)
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] maxEntries Maximum number of results kept in memory.
+	 */
+	explicit QAResultCache(int maxEntries = 1000);
+
+	/**
+	 * \brief Attach a cache to each algorithm of a graph.
+	 *
+	 * \param[in] node Any algorithm of the graph.
+	 * \param[in] cache The cache to attach, or a null pointer to detach.
+	 */
+	static void attach(const QAShrAlgorithm& node, QAResultCache* cache);
+
+	/** \brief Set the maximum number of results kept in memory. */
+	void setMaxEntries(int maxEntries);
+
+	/** \brief Maximum number of results kept in memory. */
+	int maxEntries() const;
+
+	/**
+	 * \brief Set the directory of the on-disk tier.
+	 *
+	 * \param[in] directory The directory, created if needed, or an empty
+	 * string to keep results in memory only.
+	 */
+	void setDirectory(const QString& directory);
+
+	/** \brief Directory of the on-disk tier, or an empty string. */
+	QString directory() const;
+
+	/** \brief Drop every result kept in memory; results on disk are left untouched. */
+	void clear();
+
+	/** \brief Number of lookups that found a result. */
+	qint64 hits() const;
+
+	/** \brief Number of lookups that found nothing. */
+	qint64 misses() const;
+
+	/**
+	 * \brief Compute the key of the current parameters and inputs of an algorithm.
+	 *
+	 * \return The key, or an empty array if some value cannot be hashed.
+	 */
+	static QByteArray keyOf(const QAlgorithm* node);
+
+	/**
+	 * \brief Assign a cached result to the outputs of an algorithm.
+	 *
+	 * \param[in] key The key computed by keyOf().
+	 * \param[in] node The algorithm whose outputs are assigned.
+	 * \return Whether a result has been found and assigned.
+	 */
+	bool restore(const QByteArray& key, QAlgorithm* node);
+
+	/**
+	 * \brief Store the outputs of an algorithm.
+	 *
+	 * \param[in] key The key computed by keyOf() before running the algorithm.
+	 * \param[in] node The algorithm whose outputs are stored.
+	 */
+	void insert(const QByteArray& key, const QAlgorithm* node);
+
+private:
+	QString filePath(const QByteArray& key) const;
+	bool load(const QByteArray& key, const QMetaObject* metaObject, Outputs& outputs) const;
+	void store(const QByteArray& key, const QMetaObject* metaObject, const Outputs& outputs) const;
+};
+
+#endif /* QAResultCache_h */
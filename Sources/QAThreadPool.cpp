@@ -0,0 +1,99 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include "QAThreadPool.h"
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// Settings already applied to the calling thread
+	struct ThreadState
+	{
+		const QThreadPool* pool = Q_NULLPTR;
+		int generation = -1;
+	};
+
+	thread_local ThreadState threadState;
+
+	void setAffinity(const QVector<int>& cpus)
+	{
+#ifdef Q_OS_LINUX
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(int cpu: cpus)
+		{
+			if(cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+		}
+		if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		{
+			qWarning() << "QAThreadPool: cannot set the CPU affinity to" << cpus;
+		}
+#else
+		qWarning() << "QAThreadPool: CPU affinity is not supported on this platform, ignoring" << cpus;
+#endif
+	}
+}
+
+QAThreadPool::QAThreadPool(int threads, QObject* parent) : QThreadPool(parent)
+{
+	setMaxThreadCount(threads);
+}
+
+void QAThreadPool::setThreadPriority(QThread::Priority priority)
+{
+	QMutexLocker locker(&m_lock);
+	m_priority = priority;
+	m_generation.ref();
+}
+
+QThread::Priority QAThreadPool::threadPriority() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_priority;
+}
+
+void QAThreadPool::setCpuAffinity(const QVector<int>& cpus)
+{
+	QMutexLocker locker(&m_lock);
+	m_cpus = cpus;
+	m_generation.ref();
+}
+
+QVector<int> QAThreadPool::cpuAffinity() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_cpus;
+}
+
+void QAThreadPool::prepareCurrentThread(const QThreadPool* pool)
+{
+	const QAThreadPool* custom = qobject_cast<const QAThreadPool*>(pool);
+	if(custom == Q_NULLPTR) return;
+	const int generation = custom->m_generation.loadAcquire();
+	if(threadState.pool == custom && threadState.generation == generation) return;
+	threadState.pool = custom;
+	threadState.generation = generation;
+	QMutexLocker locker(&custom->m_lock);
+	if(custom->m_priority != QThread::InheritPriority) QThread::currentThread()->setPriority(custom->m_priority);
+	if(!custom->m_cpus.isEmpty()) setAffinity(custom->m_cpus);
+}
@@ -0,0 +1,95 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QAThreadPool.h
+ *  Declarations for the QAThreadPool class.
+ */
+
+#ifndef QAThreadPool_h
+#define QAThreadPool_h
+
+#include <QtCore>
+
+/**
+ * \brief Thread pool with configurable thread priority and CPU affinity.
+ *
+ * Algorithms run on the global QThreadPool by default; a graph, or a part
+ * of it, can be isolated from the others by giving it a thread pool of its
+ * own, see QAlgorithm::setThreadPool() and QAGraphExecutor::setThreadPool().
+ * Any QThreadPool can be used, while a QAThreadPool also sets the priority
+ * and the CPU affinity of its threads.
+ *
+ * Since QThreadPool creates its threads on demand, the settings are applied
+ * by each thread to itself, before running the first algorithm after any
+ * change of the settings.
+ *
+ * \code
+ * QAThreadPool interactive(2);
+ * interactive.setThreadPriority(QThread::HighestPriority);
+ * interactive.setCpuAffinity({0, 1});
+ * QAGraphExecutor executor(closer);
+ * executor.setThreadPool(&interactive);
+ * \endcode
+ *
+ * \note CPU affinity is only supported on Linux; elsewhere it is ignored
+ * with a warning.
+ */
+class QAThreadPool : public QThreadPool
+{
+	Q_OBJECT
+
+	mutable QMutex m_lock;
+	QThread::Priority m_priority = QThread::InheritPriority;
+	QVector<int> m_cpus;
+	QAtomicInt m_generation;
+
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * \param[in] threads Maximum number of threads.
+	 * \param[in] parent Parent object.
+	 */
+	explicit QAThreadPool(int threads = QThread::idealThreadCount(), QObject* parent = Q_NULLPTR);
+
+	/** \brief Set the priority of the threads; InheritPriority leaves it untouched. */
+	void setThreadPriority(QThread::Priority priority);
+
+	/** \brief Priority of the threads. */
+	QThread::Priority threadPriority() const;
+
+	/** \brief Set the CPUs the threads can run on; an empty list leaves the affinity untouched. */
+	void setCpuAffinity(const QVector<int>& cpus);
+
+	/** \brief CPUs the threads can run on. */
+	QVector<int> cpuAffinity() const;
+
+	/**
+	 * \brief Apply the settings of the pool to the calling thread, if needed.
+	 *
+	 * This function does nothing if \e pool is not a QAThreadPool, or if the
+	 * calling thread is already up to date. It is called by every task started
+	 * by the library, so that there is no need to call it explicitly.
+	 *
+	 * \param[in] pool The pool owning the calling thread.
+	 */
+	static void prepareCurrentThread(const QThreadPool* pool);
+};
+
+#endif /* QAThreadPool_h */
@@ -18,49 +18,103 @@
 //
 
 #include "QAlgorithm.h"
+#include "QABindingPlan.h"
+#include "QAGraphSnapshot.h"
+#include "QAThreadPool.h"
+#include "QAProfiler.h"
+#include "QAResultCache.h"
 
 quint32 QAlgorithm::print_counter = 1;
 
+namespace
+{
+	// Runnable wrapping a function, deleted by the thread pool after running
+	class QAFunctionTask : public QRunnable
+	{
+		const QThreadPool* pool;
+		std::function<void()> function;
+	public:
+		QAFunctionTask(const QThreadPool* pool, std::function<void()>&& function) :
+		pool(pool), function(std::move(function)) {}
+		void run() override
+		{
+			QAThreadPool::prepareCurrentThread(pool);
+			function();
+		}
+	};
+
+	void startTask(QThreadPool* pool, std::function<void()>&& function)
+	{
+		pool->start(new QAFunctionTask(pool, std::move(function)));
+	}
+
+	// Parameters of the derived classes affect the results, inputs and execution parameters do not
+	bool affectsResults(const QMetaProperty& prop)
+	{
+		return prop.propertyIndex() >= QAlgorithm::staticMetaObject.propertyCount() &&
+		qstrncmp(prop.name(), QA_PAR, qstrlen(QA_PAR)) == 0;
+	}
+}
+
+QAOutPortBase::QAOutPortBase(QAlgorithm* owner)
+{
+	owner->outputPorts << this;
+}
+
 bool QAlgorithm::isFinished() const
 {
-	return finished;
+	return finished.loadAcquire() != 0;
 }
 
 bool QAlgorithm::isStarted() const
 {
-	return started;
+	return started.loadAcquire() != 0;
 }
 
 void QAlgorithm::setStarted()
 {
-	started = true;
+	started.storeRelease(1);
 	Q_EMIT justStarted();
 }
 
 void QAlgorithm::setFinished()
 {
-	finished = true;
+	finished.storeRelease(1);
 	Q_EMIT justFinished();
 }
 
 bool QAlgorithm::allInputsReady() const
 {
-	return !getAncestors().values().contains(false);
+	return pendingInputs.loadAcquire() == 0;
 }
 
 QACompletionMap QAlgorithm::getAncestors() const
 {
-	return ancestors;
+	QACompletionMap map;
+	for(const auto& ancestor: ancestors) map.insert(ancestor, ancestor->isFinished());
+	return map;
 }
 
 QACompletionMap QAlgorithm::getDescendants() const
+{
+	QACompletionMap map;
+	for(const auto& descendant: descendants) map.insert(descendant, descendant->isFinished());
+	return map;
+}
+
+const QAAdjacencyList& QAlgorithm::getAncestorList() const
+{
+	return ancestors;
+}
+
+const QAAdjacencyList& QAlgorithm::getDescendantList() const
 {
 	return descendants;
 }
 
 QAShrAlgorithm QAlgorithm::findAncestor(const QAlgorithm* ancestor) const
 {
-	foreach(auto& shr_ancestor, getAncestors().keys())
+	for(const auto& shr_ancestor: ancestors)
 	{
 		if (shr_ancestor == ancestor)
 		{
@@ -77,7 +131,7 @@ QAShrAlgorithm QAlgorithm::findAncestor(const QAShrAlgorithm ancestor) const
 
 QAShrAlgorithm QAlgorithm::findDescendant(const QAlgorithm* descendant) const
 {
-	foreach(auto& shr_descendant, getDescendants().keys())
+	for(const auto& shr_descendant: descendants)
 	{
 		if (shr_descendant == descendant)
 		{
@@ -94,22 +148,68 @@ QAShrAlgorithm QAlgorithm::findDescendant(const QAShrAlgorithm descendant) const
 
 QAShrAlgorithm QAlgorithm::findSharedThis() const
 {
+	// Use the self-reference registered on creation, if any
+	auto shr_this = self.toStrongRef();
+	if(!shr_this.isNull()) return shr_this;
 	// Check among the descendants
-	foreach(auto descendant, getDescendants().keys())
+	for(const auto& descendant: descendants)
 	{
-		auto shr_this = descendant->findAncestor(this);
+		shr_this = descendant->findAncestor(this);
 		if(!shr_this.isNull()) return shr_this;
 	}
 	// Otherwise check among the ancestors
-	foreach(auto ancestor, getAncestors().keys())
+	for(const auto& ancestor: ancestors)
 	{
-		auto shr_this = ancestor->findDescendant(this);
+		shr_this = ancestor->findDescendant(this);
 		if(!shr_this.isNull()) return shr_this;
 	}
 	// If nothing was found return null shared pointer
 	return QAShrAlgorithm();
 }
 
+void QAlgorithm::setSharedThis(const QAShrAlgorithm& ptr)
+{
+	if(ptr.data() != this)
+	{
+		qWarning() << "setSharedThis(): the given pointer does not own" << printName();
+		return;
+	}
+	self = ptr;
+}
+
+bool QAlgorithm::sendOutputs(QAlgorithm* child, const QABindingPlan& plan)
+{
+	const QMetaObject* parentObj = metaObject();
+	const QMetaObject* childObj = child->metaObject();
+	for(const auto& binding: plan.bindings())
+	{
+		const QMetaProperty source = parentObj->property(binding.first);
+		const QVariant value = source.read(this);
+		if(!value.isValid())
+		{
+			qWarning() << "getInput():" << source.name() << "failed to read for" << printName();
+			return false;
+		}
+		// Release the output before handing it over, so that the child holds the only reference
+		if(isLastConsumer(binding.first) && qstrncmp(source.name(), QA_OUT, qstrlen(QA_OUT)) == 0)
+		{
+			source.write(this, QVariant(source.userType(), Q_NULLPTR));
+		}
+		const QMetaProperty destination = childObj->property(binding.second);
+		if(!destination.write(child, value))
+		{
+			qWarning() << "getInput():" << destination.name() << "failed to set for" << child->printName();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool QAlgorithm::isLastConsumer(int property) const
+{
+	return property >= 0 && property < consumerCounts.size() && consumerCounts[property] == 1;
+}
+
 QAlgorithm::QAlgorithm(QObject* parent) : QObject(parent), QRunnable()
 {
 	qRegisterMetaType<QAPropertyMap>();
@@ -119,26 +219,63 @@ QAlgorithm::QAlgorithm(QObject* parent) : QObject(parent), QRunnable()
 
 void QAlgorithm::setParameters(const QAPropertyMap& parameters)
 {
-	// Scan the object properties
-	for(const QString& PropName: parameters.keys())
+	// The properties are found by base name in the index of this class
+	const QAPropertyIndex index = QAPropertyIndex::of(metaObject());
+	bool dirty = false;
+	for(auto it = parameters.cbegin(); it != parameters.cend(); ++it)
 	{
-		bool set = false;
-		for(int k = 0; k < metaObject()->propertyCount(); ++k)
+		const QVector<int> properties = index.settable(it.key());
+		if(properties.isEmpty())
+		{
+			qWarning() << "Trying to set" << it.key() << "but it is not among object's properties";
+			continue;
+		}
+		for(int k: properties)
 		{
-			if(metaObject()->property(k).name() == QA_PAR + PropName ||
-			   metaObject()->property(k).name() == QA_IN + PropName)
+			// This property is a parameter or an input
+			// Write the desired value in the property
+			const QMetaProperty prop = metaObject()->property(k);
+			if(!prop.write(this, it.value()))
 			{
-				// This property is a parameter or an input
-				// Write the desired value in the property
-				if (!setProperty(metaObject()->property(k).name(), parameters.value(PropName)))
-				{
-					qWarning() << "Cannot set parameter/input" << PropName;
-				}
-				set = true;
+				qWarning() << "Cannot set parameter/input" << it.key();
 			}
+			else dirty = dirty || affectsResults(prop);
+		}
+	}
+	// Inputs and execution parameters do not mark the algorithm dirty by themselves
+	if(dirty) markDirty();
+}
+
+QAParameterHandle QAlgorithm::parameterHandle(const QString& name) const
+{
+	return QAPropertyIndex::of(metaObject()).handle(name);
+}
+
+bool QAlgorithm::setParameter(const QAParameterHandle& handle, const QVariant& value)
+{
+	if(handle.metaObject() != metaObject())
+	{
+		qWarning() << "setParameter():" << handle.name() << "has been resolved for another class than" << printName();
+		return false;
+	}
+	if(!handle.isValid())
+	{
+		qWarning() << "Trying to set" << handle.name() << "but it is not among object's properties";
+		return false;
+	}
+	bool ok = true, dirty = false;
+	for(int k: handle.properties())
+	{
+		const QMetaProperty prop = metaObject()->property(k);
+		if(!prop.write(this, value))
+		{
+			qWarning() << "Cannot set parameter/input" << handle.name();
+			ok = false;
 		}
-		if(!set) qWarning() << "Trying to set" << PropName << "but it is not among object's properties";
+		else dirty = dirty || affectsResults(prop);
 	}
+	if(dirty) markDirty();
+	return ok;
 }
 
 void QAlgorithm::setup()
@@ -146,114 +283,423 @@ void QAlgorithm::setup()
 	// Prevent the QThreadPool to delete a parent instance
 	setAutoDelete(false);
 	// Make internal connections
-	connect(this, &QAlgorithm::justFinished, this, &QAlgorithm::propagateExecution, Qt::AutoConnection);
-	connect(&watcher, &QFutureWatcher<void>::finished, this, &QAlgorithm::setFinished, Qt::AutoConnection);
+	// Propagation is direct, so that it can check whether a QAGraphExecutor is in charge
+	connect(this, &QAlgorithm::justFinished, this, &QAlgorithm::propagateExecution, Qt::DirectConnection);
+}
+
+void QAlgorithm::releaseInputs()
+{
+	for(int k = 0; k < metaObject()->propertyCount(); ++k)
+	{
+		QMetaProperty prop = metaObject()->property(k);
+		if(qstrncmp(prop.name(), QA_IN, qstrlen(QA_IN)) == 0)
+		{
+			// Writing a null QVariant would append an element to input lists
+			if(prop.isResettable()) prop.reset(this);
+			else prop.write(this, QVariant());
+		}
+	}
+}
+
+bool QAlgorithm::resetInputs()
+{
+	bool ok = true;
+	for(int k = 0; k < metaObject()->propertyCount(); ++k)
+	{
+		QMetaProperty prop = metaObject()->property(k);
+		if(qstrncmp(prop.name(), QA_IN, qstrlen(QA_IN)) != 0 &&
+		   qstrncmp(prop.name(), QA_PORT_IN, qstrlen(QA_PORT_IN)) != 0) continue;
+		if(!prop.isResettable() || !prop.reset(this))
+		{
+			qWarning() << "rearm():" << prop.name() << "cannot be reset for" << printName();
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+void QAlgorithm::rearmNode()
+{
+	resetInputs();
+	enqueuedAt = -1;
+	started.storeRelease(0);
+	finished.storeRelease(0);
+	// Every ancestor is rearmed too, and will deliver its outputs again
+	pendingInputs.storeRelease(ancestors.size());
+}
+
+bool QAlgorithm::rearm()
+{
+	// Collect the whole graph, starting from this instance
+	QVector<QAlgorithm*> graph;
+	QSet<QAlgorithm*> visited;
+	graph << this;
+	visited.insert(this);
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		QAlgorithm* node = graph[k];
+		if(node->isStarted() && !node->isFinished())
+		{
+			qWarning() << "rearm():" << node->printName() << "is still running";
+			return false;
+		}
+		for(const auto& ancestor: node->ancestors)
+		{
+			if(!visited.contains(ancestor.data()))
+			{
+				visited.insert(ancestor.data());
+				graph << ancestor.data();
+			}
+		}
+		for(const auto& descendant: node->descendants)
+		{
+			if(!visited.contains(descendant.data()))
+			{
+				visited.insert(descendant.data());
+				graph << descendant.data();
+			}
+		}
+	}
+	for(QAlgorithm* node: graph) node->rearmNode();
+	return true;
+}
+
+bool QAlgorithm::markDirty()
+{
+	// Nothing to do if this instance is already dirty, or has never run
+	if(!isFinished()) return true;
+	// Collect the descendants, and the clean ancestors whose outputs cannot be delivered again
+	QVector<QAlgorithm*> dirty;
+	QSet<QAlgorithm*> visited;
+	dirty << this;
+	visited.insert(this);
+	for(int k = 0; k < dirty.size(); ++k)
+	{
+		QAlgorithm* node = dirty[k];
+		if(node->isStarted() && !node->isFinished())
+		{
+			qWarning() << "markDirty():" << node->printName() << "is still running";
+			return false;
+		}
+		for(const auto& descendant: node->descendants)
+		{
+			if(!visited.contains(descendant.data()))
+			{
+				visited.insert(descendant.data());
+				dirty << descendant.data();
+			}
+		}
+		for(const auto& ancestor: node->ancestors)
+		{
+			if(visited.contains(ancestor.data()) || !ancestor->isFinished()) continue;
+			bool released = !ancestor->getKeepOutput();
+			for(const auto& link: node->portLinks)
+			{
+				released = released || (link.source == ancestor.data() && link.moveOnly);
+			}
+			if(released)
+			{
+				visited.insert(ancestor.data());
+				dirty << ancestor.data();
+			}
+		}
+	}
+	for(QAlgorithm* node: dirty)
+	{
+		node->enqueuedAt = -1;
+		node->started.storeRelease(0);
+		node->finished.storeRelease(0);
+	}
+	// Clean ancestors deliver their kept outputs now, dirty ones when they finish
+	for(QAlgorithm* node: dirty)
+	{
+		if(node->ancestors.isEmpty()) continue;
+		node->resetInputs();
+		int pending = 0;
+		for(const auto& ancestor: node->ancestors)
+		{
+			if(ancestor->isFinished()) node->fetchInput(ancestor);
+			else ++pending;
+		}
+		node->pendingInputs.storeRelease(pending);
+	}
+	return true;
+}
+
+void QAlgorithm::countConsumers(const QAAdjacencyList& consumers, QVector<QABindingPlan>& plans)
+{
+	plans.clear();
+	plans.reserve(consumers.size());
+	consumerCounts.fill(0, metaObject()->propertyCount());
+	for(const auto& consumer: consumers)
+	{
+		plans << QABindingPlan::resolve(this, consumer.data());
+		for(const auto& binding: plans.last().bindings()) ++consumerCounts[binding.first];
+	}
+}
+
+void QAlgorithm::releaseConsumedOutputs(const QABindingPlan& plan)
+{
+	for(const auto& binding: plan.bindings())
+	{
+		if(--consumerCounts[binding.first] > 0) continue;
+		// The last consumer has been served: drop this instance's reference to the payload,
+		// so that an implicitly shared one is not detached by the consumer
+		QMetaProperty prop = metaObject()->property(binding.first);
+		if(qstrncmp(prop.name(), QA_OUT, qstrlen(QA_OUT)) == 0)
+		{
+			prop.write(this, QVariant(prop.userType(), Q_NULLPTR));
+		}
+	}
+	for(QAOutPortBase* port: outputPorts) port->clear();
+}
+
+void QAlgorithm::clearConsumers()
+{
+	consumerCounts.clear();
+}
+
+void QAlgorithm::dropConnections()
+{
+	for(const auto& link: portLinks) link.output->m_consumers.deref();
+	portLinks.clear();
+	ancestors.clear();
+	descendants.clear();
+}
+
+void QAlgorithm::recycle()
+{
+	dropConnections();
+	// Signal connections are made again by setup()
+	disconnect();
+	setObjectName(QString());
+	rearmNode();
+	for(int k = 0; k < metaObject()->propertyCount(); ++k)
+	{
+		QMetaProperty prop = metaObject()->property(k);
+		if(qstrncmp(prop.name(), QA_OUT, qstrlen(QA_OUT)) == 0)
+		{
+			prop.write(this, QVariant(prop.userType(), Q_NULLPTR));
+		}
+	}
+	for(QAOutPortBase* port: outputPorts) port->clear();
+	self.clear();
+	threadPool = Q_NULLPTR;
+	profiler = Q_NULLPTR;
+	resultCache = Q_NULLPTR;
+	managed = false;
+	consumerCounts.clear();
 }
 
 void QAlgorithm::propagateExecution()
 {
+	// Descendants are handled by the executor, if any
+	if(managed) return;
 	auto shr_this = findSharedThis();
 	if(!shr_this.isNull())
 	{
-		// Notify ancestors
-		foreach(auto ancestor, getAncestors().keys()) ancestor->descendants[shr_this] = true;
 		// Notify descendants, transfer output to and execute them
-		foreach(auto descendant, getDescendants().keys())
+		// (iterate over a copy, since connections may be closed in the loop)
+		const QAAdjacencyList descendantList = descendants;
+		// Count the consumers of each output, in order to release it after its last transfer
+		QVector<QABindingPlan> plans;
+		// Descendants packed into batches, see TaskGranularity
+		const bool batched = getParallelExecution() && getTaskGranularity() > 0;
+		QAAdjacencyList ready;
+		// Only the time spent serving the descendants is profiled, not their execution
+		qint64 begin = profiler ? profiler->now() : 0;
+		if(!getKeepOutput()) countConsumers(descendantList, plans);
+		for(int k = 0; k < descendantList.size(); ++k)
 		{
-			descendant->ancestors[shr_this] = true;
-			descendant->getInput(shr_this);
+			const auto& descendant = descendantList[k];
+			descendant->pendingInputs.deref();
+			descendant->fetchInput(shr_this);
+			if(!plans.isEmpty()) releaseConsumedOutputs(plans[k]);
 			if(!descendant->getKeepInput())
 			{
 				QAlgorithm::closeConnection(shr_this, descendant);
 				// Set each input property to null
 				// useful if input has been received with implicit sharing
-				for(int k = 0; k < metaObject()->propertyCount(); ++k)
-				{
-					if(QString(metaObject()->property(k).name()).startsWith(QA_IN))
-					{
-						setProperty(metaObject()->property(k).name(), QVariant());
-					}
-				}
+				releaseInputs();
 			}
-			if(!descendant->isStarted())
+			if(profiler)
+			{
+				qint64 end = profiler->now();
+				profiler->record(QAProfiler::Propagation, this, begin, end, descendant.data());
+				if(!descendant->isStarted() && getParallelExecution()) descendant->enqueuedAt = end;
+			}
+			if(batched)
+			{
+				// Claim the descendant, so that no other ancestor starts it
+				if(descendant->allInputsReady() && descendant->started.testAndSetOrdered(0, 1)) ready << descendant;
+			}
+			else if(!descendant->isStarted())
 			{
 				if (getParallelExecution()) descendant->parallelExecution();
 				else descendant->serialExecution();
 			}
+			if(profiler) begin = profiler->now();
 		}
+		clearConsumers();
+		if(!ready.isEmpty()) startBatches(ready);
 	}
 }
 
-bool QAlgorithm::getInput(QAShrAlgorithm parent)
+bool QAlgorithm::fetchInput(const QAShrAlgorithm& parent)
+{
+	if(!profiler) return getInput(parent);
+	qint64 begin = profiler->now();
+	bool ok = getInput(parent);
+	profiler->record(QAProfiler::Input, this, begin, profiler->now(), parent.data());
+	return ok;
+}
+
+void QAlgorithm::perform()
 {
-	// Create an alias to this for better readability
-	auto child = this;
-	// Scan parent's properties and grab all the possible outputs and parameters
-	for(int k = 0; k < parent->metaObject()->propertyCount(); ++k)
+	// A cached result replaces run()
+	QByteArray cacheKey;
+	if(resultCache)
 	{
-		QString parentPropName = parent->metaObject()->property(k).name();
-		// Get the parent's property base name
-		// Both output and parameter properties are checked
-		QString parentPropBaseName;
-		if(parentPropName.startsWith(QA_OUT))
-		{
-			// Output property
-			parentPropBaseName = parentPropName.mid(strlen(QA_OUT));
-		}
-		else if(parentPropName.startsWith(QA_PAR))
+		cacheKey = QAResultCache::keyOf(this);
+		if(!cacheKey.isEmpty() && resultCache->restore(cacheKey, this))
 		{
-			// Parameter
-			parentPropBaseName = parentPropName.mid(strlen(QA_PAR));
+			enqueuedAt = -1;
+			return;
 		}
-		else continue;
-		// Get the child's property base name, based on PropagationRules values
-		QString childPropBaseName;
-		if(!getPropagationRules().contains(parentPropBaseName))
+	}
+	const bool measure = getCostHint() < 0;
+	if(!profiler && !measure)
+	{
+		run();
+		if(!cacheKey.isEmpty()) resultCache->insert(cacheKey, this);
+		return;
+	}
+	qint64 begin = profiler ? profiler->now() : 0;
+	if(profiler && enqueuedAt >= 0) profiler->record(QAProfiler::Queue, this, enqueuedAt, begin);
+	enqueuedAt = -1;
+	QElapsedTimer timer;
+	if(measure) timer.start();
+	run();
+	if(measure)
+	{
+		const qint64 elapsed = timer.nsecsElapsed();
+		// Only one thread runs this instance at a time, while others may read the cost
+		const qint64 previous = measuredCost.loadAcquire();
+		measuredCost.storeRelease(previous < 0 ? elapsed : (3 * previous + elapsed) / 4);
+	}
+	if(profiler) profiler->record(QAProfiler::Run, this, begin, profiler->now());
+	if(!cacheKey.isEmpty()) resultCache->insert(cacheKey, this);
+}
+
+qint64 QAlgorithm::getCost() const
+{
+	return getCostHint() >= 0 ? getCostHint() : measuredCost.loadAcquire();
+}
+
+void QAlgorithm::runInline()
+{
+	setStarted();
+	perform();
+	// Completion is notified in the thread this instance lives in, so that
+	// sibling batches never propagate their outputs concurrently
+	QMetaObject::invokeMethod(this, [this]()
+							  {
+								  setFinished();
+							  }, Qt::QueuedConnection);
+}
+
+void QAlgorithm::startBatches(const QAAdjacencyList& ready) const
+{
+	const qint64 granularity = getTaskGranularity();
+	QAAdjacencyList batch;
+	qint64 total = 0;
+	auto start = [](const QAAdjacencyList& task)
+	{
+		startTask(task.first()->getThreadPool(), [task]()
+				  {
+					  for(const auto& descendant: task) descendant->runInline();
+				  });
+	};
+	for(const auto& descendant: ready)
+	{
+		qint64 cost = descendant->getCost();
+		if(cost < 0) cost = granularity;
+		// Descendants assigned to different thread pools are never packed together
+		if(!batch.isEmpty() && (total + cost > granularity || descendant->getThreadPool() != batch.first()->getThreadPool()))
 		{
-			childPropBaseName = parentPropBaseName;
+			start(batch);
+			batch.clear();
+			total = 0;
 		}
-		else
+		batch << descendant;
+		total += cost;
+	}
+	if(!batch.isEmpty()) start(batch);
+}
+
+void QAlgorithm::setThreadPool(QThreadPool* pool)
+{
+	threadPool = pool;
+}
+
+void QAlgorithm::setSubtreeThreadPool(QThreadPool* pool)
+{
+	// Iterative visit of the descendants
+	QVector<QAlgorithm*> subtree;
+	QSet<QAlgorithm*> visited;
+	subtree << this;
+	visited.insert(this);
+	for(int k = 0; k < subtree.size(); ++k)
+	{
+		subtree[k]->setThreadPool(pool);
+		for(const auto& descendant: subtree[k]->descendants)
 		{
-			// The values associated with the given key
-			auto values = getPropagationRules().values(parentPropBaseName);
-			if(values.size() > 1)
+			if(!visited.contains(descendant.data()))
 			{
-				// If there are more than one value, then use the first one that contain the parent object name
-				childPropBaseName = values.filter(parent->objectName()).first();
+				visited.insert(descendant.data());
+				subtree << descendant.data();
 			}
-			else
-			{
-				childPropBaseName = values.first();
-			}
-		}
-		// Parameters are sent only if they are explicitly mentioned in the PropagationRules
-		if(parentPropName.startsWith(QA_PAR) && !getPropagationRules().contains(parentPropBaseName))
-		{
-			continue;
 		}
-		// Check if the property is in child's input or parameter properties
-		for(int i = 0; i < child->metaObject()->propertyCount(); ++i)
+	}
+}
+
+QThreadPool* QAlgorithm::getThreadPool() const
+{
+	return threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+void QAlgorithm::setProfiler(QAProfiler* profiler)
+{
+	this->profiler = profiler;
+}
+
+QAProfiler* QAlgorithm::getProfiler() const
+{
+	return profiler;
+}
+
+void QAlgorithm::setResultCache(QAResultCache* cache)
+{
+	resultCache = cache;
+}
+
+QAResultCache* QAlgorithm::getResultCache() const
+{
+	return resultCache;
+}
+
+bool QAlgorithm::getInput(QAShrAlgorithm parent)
+{
+	// The bindings between parent's and child's properties are resolved only once
+	// for each pair of classes, then a cached plan is used
+	if(!parent->sendOutputs(this, QABindingPlan::resolve(parent.data(), this))) return false;
+	// Typed port connections are served with a direct assignment
+	for(const auto& link: portLinks)
+	{
+		if(link.source == parent.data())
 		{
-			QString childPropName = child->metaObject()->property(i).name();
-			// If the current property corresponds to an input with the same base name as before,
-			// then assign it; the same will be done also for parameters.
-			if(childPropName == QA_IN+childPropBaseName || childPropName == QA_PAR+childPropBaseName)
-			{
-				QVariant parentProp = parent->property(parentPropName.toStdString().c_str());
-				if(parentProp.isValid())
-				{
-					if(!child->setProperty(childPropName.toStdString().c_str(), parentProp))
-					{
-						qWarning() << "getInput():" << childPropName << "failed to set for" << child->printName();
-						return false;
-					}
-				}
-				else
-				{
-					qWarning() << "getInput():" << parentPropName << "failed to read for" << parent->printName();
-					return false;
-				}
-			}
+			bool last = link.output->deliver();
+			link.transfer(last && (link.moveOnly || !parent->getKeepOutput()));
 		}
 	}
 	return true;
@@ -266,16 +712,24 @@ void QAlgorithm::parallelExecution()
 	{
 		// Perform the core part of the algorithm is a separate thread
 		setStarted();
-		result = QtConcurrent::run(this, &QAlgorithm::run);
-		watcher.setFuture(result);
+		if(profiler && enqueuedAt < 0) enqueuedAt = profiler->now();
+		startTask(getThreadPool(), [this]()
+				  {
+					  perform();
+					  // Completion is notified in the thread this instance lives in
+					  QMetaObject::invokeMethod(this, [this]()
+												{
+													setFinished();
+												}, Qt::QueuedConnection);
+				  });
 	}
 	else
 	{
 		// Run those not started
-		for(const auto& ancestor: getAncestors().keys(false))
+		for(const auto& ancestor: ancestors)
 		{
 			// Only start processes not already started
-			if(!ancestor->isStarted()) ancestor->parallelExecution();
+			if(!ancestor->isFinished() && !ancestor->isStarted()) ancestor->parallelExecution();
 		}
 	}
 }
@@ -286,17 +740,19 @@ void QAlgorithm::serialExecution()
 	if(!allInputsReady())
 	{
 		// Run those not started
-		for(const auto& ancestor: getAncestors().keys(false))
+		for(const auto& ancestor: ancestors)
 		{
 			// Only start processes not already started
-			if(!ancestor->isStarted()) ancestor->serialExecution();
+			if(!ancestor->isFinished() && !ancestor->isStarted()) ancestor->serialExecution();
 		}
+		// The last ancestor may have already run this algorithm while propagating
+		if(isStarted()) return;
 	}
 	// Set the ParallelExecution policy to false
 	setParallelExecution(false);
 	// Perform the core part of the algorithm in the same thread
 	setStarted();
-	run();
+	perform();
 	setFinished();
 }
 
@@ -328,9 +784,9 @@ void QAlgorithm::printGraph(const QString &path) const
 		QLocale nospace;
 		nospace.setNumberOptions(QLocale::NumberOption::OmitGroupSeparator);
 		dot << "digraph g{\n";
-		auto flatMap = flattenTree();
+		const QAGraphSnapshot graph = snapshot();
 		// Save node labels
-		foreach(auto alg, flatMap.keys())
+		for(const auto& alg: graph.nodes())
 		{
 			QString id = nospace.toString(quint64(alg.data()));
 			QString idspace = QLocale().toString(quint64(alg.data()));
@@ -342,12 +798,12 @@ void QAlgorithm::printGraph(const QString &path) const
 			dot << dotstring;
 		}
 		// Save connections between nodes
-		foreach(auto parent, flatMap.keys())
+		for(int k = 0; k < graph.size(); ++k)
 		{
-			QString parentName = "var" + nospace.toString(quint64(parent.data()));
-			foreach(auto child, flatMap[parent])
+			QString parentName = "var" + nospace.toString(quint64(graph.node(k).data()));
+			for(int child: graph.descendants(k))
 			{
-				QString childName = "var" + nospace.toString(quint64(child.data()));
+				QString childName = "var" + nospace.toString(quint64(graph.node(child).data()));
 				dot << parentName << " -> " << childName << "\n";
 			}
 		}
@@ -399,64 +855,71 @@ QString QAlgorithm::printName() const
 
 QAFlatRepresentation QAlgorithm::flattenTree(QAFlatRepresentation tree) const
 {
-	// Search for a shared pointer attached to this instance
-	auto keysList = tree.keys();
-	// Check if the function has already been applied to this
-	auto shr_this_it = std::find_if(keysList.begin(), keysList.end(), [this](auto& ptr)
-									{return ptr == this;}
-									);
-	if (shr_this_it == keysList.end())
-	{
-		// Otherwise link each descendant to this in the map
-		auto shr_this = findSharedThis();
-		if(shr_this.isNull()) qWarning() << "This instance has no properly set connection, flattenTree will not work";
-		else
-		{
-			// Insert shr_this as new key in the map
-			tree[shr_this] = QSet<QAShrAlgorithm>();
-			// Append each descendant to it
-			for (auto descendant: getDescendants().keys()) tree[shr_this] << descendant;
-			// Recursive step: apply the function to each relative not yet scanned
-			for (auto relative: getDescendants().keys()+getAncestors().keys())
-			{
-				if (!tree.contains(relative)) tree = relative->flattenTree(tree);
-			}
-		}
+	const QAGraphSnapshot graph = snapshot();
+	if(tree.isEmpty()) return graph.toFlatRepresentation();
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		QSet<QAShrAlgorithm>& children = tree[graph.node(k)];
+		for(int descendant: graph.descendants(k)) children << graph.node(descendant);
 	}
-	else qWarning() << "flattenTree: possible loop";
 	return tree;
 }
 
+QAGraphSnapshot QAlgorithm::snapshot() const
+{
+	auto shr_this = findSharedThis();
+	if(shr_this.isNull())
+	{
+		qWarning() << "This instance has no properly set connection, snapshot will not work";
+		return QAGraphSnapshot();
+	}
+	return QAGraphSnapshot(shr_this);
+}
+
 void QAlgorithm::setConnection(QAShrAlgorithm ancestor, QAShrAlgorithm descendant)
 {
-	ancestor->descendants[descendant] = descendant->isFinished();
-	descendant->ancestors[ancestor] = ancestor->isFinished();
+	if(QAlgorithm::checkConnection(ancestor, descendant)) return;
+	ancestor->descendants.append(descendant);
+	descendant->ancestors.append(ancestor);
+	// The descendant has to wait for this ancestor only if it has not run yet
+	if(!ancestor->isFinished()) descendant->pendingInputs.ref();
 	connect(ancestor.data(), &QAlgorithm::raise, descendant.data(), &QAlgorithm::abort, Qt::QueuedConnection);
 	connect(descendant.data(), &QAlgorithm::raise, ancestor.data(), &QAlgorithm::abort, Qt::QueuedConnection);
 }
 
 void QAlgorithm::closeConnection(QAShrAlgorithm ancestor, QAShrAlgorithm descendant)
 {
-	ancestor->descendants.remove(descendant);
-	descendant->ancestors.remove(ancestor);
+	if(!QAlgorithm::checkConnection(ancestor, descendant)) return;
+	ancestor->descendants.removeOne(descendant);
+	descendant->ancestors.removeOne(ancestor);
+	for(int k = descendant->portLinks.size() - 1; k >= 0; --k)
+	{
+		if(descendant->portLinks[k].source == ancestor.data())
+		{
+			descendant->portLinks[k].output->m_consumers.deref();
+			descendant->portLinks.removeAt(k);
+		}
+	}
+	// An ancestor not yet finished will never deliver its outputs to the descendant
+	if(!ancestor->isFinished()) descendant->pendingInputs.deref();
 	disconnect(ancestor.data(), &QAlgorithm::raise, descendant.data(), &QAlgorithm::abort);
 	disconnect(descendant.data(), &QAlgorithm::raise, ancestor.data(), &QAlgorithm::abort);
 }
 
 bool QAlgorithm::checkConnection(QAShrAlgorithm ancestor, QAShrAlgorithm descendant)
 {
-	return ancestor->getDescendants().contains(descendant) && descendant->getAncestors().contains(ancestor);
+	return ancestor->descendants.contains(descendant) && descendant->ancestors.contains(ancestor);
 }
 
 bool QAlgorithm::isRemovableConnection(QAShrAlgorithm p1, QAShrAlgorithm p2)
 {
 	if (QAlgorithm::checkConnection(p2, p1))
 	{
-		return (p2->getDescendants().count() == 1) && (p1->getAncestors().count() == 1);
+		return (p2->descendants.count() == 1) && (p1->ancestors.count() == 1);
 	}
 	else if (QAlgorithm::checkConnection(p1, p2))
 	{
-		return (p1->getDescendants().count() == 1) && (p2->getAncestors().count() == 1);
+		return (p1->descendants.count() == 1) && (p2->ancestors.count() == 1);
 	}
 	else return false;
 }
@@ -488,9 +951,9 @@ QDebug operator<<(QDebug debug, const QAlgorithm& c)
 		QMetaProperty prop = obj->property(k);
 		// Check whether the current property's name starts with "algin_"
 		QString propName = prop.name();
-		if(propName.startsWith(QA_IN))
+		if(propName.startsWith(QA_IN) || propName.startsWith(QA_PORT_IN))
 		{
-			propName.remove(QA_IN);
+			propName.remove(QA_IN).remove(QA_PORT_IN);
 			debug << propName.rightJustified(30,' ',true) << "\t" << prop.read(&c) << endl;
 		}
 	}
@@ -516,9 +979,9 @@ QDebug operator<<(QDebug debug, const QAlgorithm& c)
 		QMetaProperty prop = obj->property(k);
 		// Check whether the current property's name starts with "algout_"
 		QString propName = prop.name();
-		if(propName.startsWith(QA_OUT))
+		if(propName.startsWith(QA_OUT) || propName.startsWith(QA_PORT_OUT))
 		{
-			propName = propName.remove(QA_OUT);
+			propName = propName.remove(QA_OUT).remove(QA_PORT_OUT);
 			debug << propName.rightJustified(30,' ',true) << "\t" << prop.read(&c) << endl;
 		}
 	}
@@ -530,63 +993,70 @@ QDebug operator<<(QDebug debug, const QAlgorithm& c)
 
 void QAlgorithm::printTree(const QAFlatRepresentation& tree) const
 {
-	auto _printTree = [](decltype(tree) map)
+	if (tree.isEmpty())
 	{
-		foreach(auto key, map.keys())
+		const QAGraphSnapshot graph = snapshot();
+		for(int k = 0; k < graph.size(); ++k)
 		{
-			qInfo() << "key" << key->printName();
-			foreach(auto value, map[key])
+			qInfo() << "key" << graph.node(k)->printName();
+			for(int value: graph.descendants(k))
 			{
-				qInfo() << "\tvalue" << value->printName();
+				qInfo() << "\tvalue" << graph.node(value)->printName();
 			}
 		}
 	}
-	;
-	if (tree.isEmpty()) _printTree(flattenTree());
-	else _printTree(tree);
-}
-
-void QAlgorithm::improveTree(QAlgorithm* leaf)
-{
-	auto flatMap = leaf->flattenTree();
-	QMap<QAShrAlgorithm, QList<QAShrAlgorithm>> replacements;
-	foreach (auto ptr, flatMap.uniqueKeys())
+	else
 	{
-		foreach(auto child, flatMap[ptr])
+		for(auto it = tree.cbegin(); it != tree.cend(); ++it)
 		{
-			if (QAlgorithm::isRemovableConnection(ptr, child))
+			qInfo() << "key" << it.key()->printName();
+			for(const auto& value: it.value())
 			{
-				// Insert a new replacement (assuming uniqueness of flat map keys)
-				replacements[ptr] << child;
+				qInfo() << "\tvalue" << value->printName();
 			}
 		}
 	}
-	// From the set of removable connection, link the pairs that form a removable connection all together
-	bool some_changes = true;
-	while(some_changes)
+}
+
+void QAlgorithm::improveTree(QAlgorithm* leaf, qint64 granularity)
+{
+	const QAGraphSnapshot graph = leaf->snapshot();
+	QVector<qint64> costs(graph.size());
+	for(int k = 0; k < graph.size(); ++k) costs[k] = graph.node(k)->getCost();
+	// Whether the only connection leaving k is removable
+	auto removable = [&graph](int k)
 	{
-		some_changes = false;
-		foreach(auto p1, replacements.keys())
+		const auto children = graph.descendants(k);
+		return children.size() == 1 && graph.ancestors(children[0]).size() == 1;
+	};
+	for(int k = 0; k < graph.size(); ++k)
+	{
+		// Walk each chain of removable connections from its head, once
+		const auto parents = graph.ancestors(k);
+		const bool head = parents.size() != 1 || !removable(parents[0]);
+		if(head && removable(k))
 		{
-			// Take the last element in the list of removable connections
-			auto p2 = replacements[p1].last();
-			// If it has its own removable connections, add them to p1's
-			if (replacements.contains(p2))
+			// Fuse the chain into tasks not exceeding the granularity
+			qint64 total = qMax(costs[k], qint64(0));
+			for(int current = k; removable(current); current = graph.descendants(current)[0])
 			{
-				replacements[p1] += replacements.take(p2);
-				some_changes = true;
-				break; // recompute keys after any change
+				const int next = graph.descendants(current)[0];
+				const qint64 cost = qMax(costs[next], qint64(0));
+				const bool fuse = costs[current] < granularity && cost < granularity && total + cost <= granularity;
+				graph.node(current)->setParallelExecution(!fuse);
+				total = fuse ? total + cost : cost;
 			}
 		}
-	}
-	// Create the envelopes for each replacement
-	foreach(QList<QAShrAlgorithm> nodes, replacements.values())
-	{
-		// Tell each node, except the last, to serially execute its children
-		nodes.removeLast();
-		foreach(auto node, nodes)
+		// Pack the cheap descendants of a fan-out into batches
+		const auto children = graph.descendants(k);
+		if(children.size() > 1)
 		{
-			node->setParallelExecution(false);
+			int cheap = 0;
+			for(int child: children)
+			{
+				if(costs[child] >= 0 && costs[child] < granularity) ++cheap;
+			}
+			if(cheap > 1) graph.node(k)->setTaskGranularity(granularity);
 		}
 	}
 }
@@ -600,7 +1070,8 @@ QDataStream& operator<<(QDataStream& stream, const QAlgorithm& c)
 		QString propName = prop.name();
 		QVariant propValue = prop.read(&c);
 		if(propValue.isValid() &&
-		   (propName.startsWith(QA_IN) || propName.startsWith(QA_OUT) || propName.startsWith(QA_PAR)))
+		   (propName.startsWith(QA_IN) || propName.startsWith(QA_OUT) || propName.startsWith(QA_PAR) ||
+			propName.startsWith(QA_PORT_IN) || propName.startsWith(QA_PORT_OUT)))
 			properties.insert(propName, propValue);
 	}
 	return (stream << properties);
@@ -27,13 +27,21 @@
 #include <QtCore>
 #include <QtConcurrent/qtconcurrentrun.h>
 #include "qa_macros.h"
+#include "QAPort.h"
+#include "QAPropertyIndex.h"
+#include "QANodePool.h"
 
 class QAlgorithm;
+class QABindingPlan;
+class QAGraphSnapshot;
+class QAProfiler;
+class QAResultCache;
 
 typedef QSharedPointer<QAlgorithm> QAShrAlgorithm;
 typedef QMap<QString, QVariant> QAPropertyMap;
 typedef QMultiMap<QString, QString> QAPropagationRules;
 typedef QMap<QAShrAlgorithm, bool> QACompletionMap;
+typedef QVector<QAShrAlgorithm> QAAdjacencyList;
 typedef QMap<QAShrAlgorithm, QSet<QAShrAlgorithm>> QAFlatRepresentation;
 
 Q_DECLARE_METATYPE(QAPropertyMap)
@@ -62,7 +70,9 @@ Q_DECLARE_METATYPE(QAShrAlgorithm)
  * 
  * Generally you should use the methods serialExecution() (using the same thread)
  * or parallelExecution() (using as many thread as possible) to run the whole
- * algorithm tree. The connections you established between algorithms
+ * algorithm tree. A whole graph can also be run by a QAGraphExecutor, that
+ * schedules ready algorithms directly from the worker threads.
+ * The connections you established between algorithms
  * take care of passing outputs and parameters from parents to children;
  * this is controlled by the so called \e PropagationRules. This is basically
  * a map of strings to strings, where the name of parent's property is mapped
@@ -81,11 +91,31 @@ Q_DECLARE_METATYPE(QAShrAlgorithm)
  * computation ends, and the connection with children is closed as soon as
  * properties have been passed to them.
  * 
+ * Similarly, every algorithm has a boolean parameter called \e KeepOutput, true
+ * by default. If it is set to false, each output property is reset to its
+ * default value as soon as it has been passed to its last consumer, and
+ * outputs that no descendant consumes are always kept. This saves a copy
+ * only for implicitly shared types (QVector, QByteArray, QImage, ...): the
+ * last consumer becomes the only owner of the payload, and does not need to
+ * detach it when modifying its input (e.g. through the getInRef\<\e Name\>
+ * getter). Other types, such as std::vector, are still deep-copied by the
+ * transfer through QVariant; large payloads of such types should be sent
+ * through typed ports, see QA_OUTPUT_PORT(), that are moved to their last
+ * consumer.
+ * 
  * Every algorithm has also a \e ParallelExecution property (not to be confused with
  * the method with the same name). This is a boolean value stating whether its
  * children will be run in a different thread or in the same one. Forcing serial
  * execution only for some connections can be useful if an algorithm's output
  * is huge and can be processed immediately by its children.
+ *
+ * The cost of an algorithm, i.e. the duration of its run() function, can be
+ * declared with the \e CostHint parameter (in nanoseconds); otherwise it is
+ * measured on each execution, see getCost(). Costs drive improveTree(), that
+ * fuses chains of cheap algorithms into single tasks, and the \e TaskGranularity
+ * parameter: when it is positive, the descendants that become ready together
+ * are packed into tasks whose total cost does not exceed it, instead of
+ * starting a task for each of them.
  * 
  * An algorithm may also have multiple parents; in this case it is good
  * for children algorithms to have a container to store all parents' outputs.
@@ -98,9 +128,12 @@ class QAlgorithm : public QObject, public QRunnable
 	
 	Q_OBJECT
 	
-	QA_PARAMETER(bool, KeepInput, false)
-	QA_PARAMETER(QAPropagationRules, PropagationRules, QAPropagationRules())
-	QA_PARAMETER(bool, ParallelExecution, true)
+	QA_EXECUTION_PARAMETER(bool, KeepInput, false)
+	QA_EXECUTION_PARAMETER(bool, KeepOutput, true)
+	QA_EXECUTION_PARAMETER(QAPropagationRules, PropagationRules, QAPropagationRules())
+	QA_EXECUTION_PARAMETER(bool, ParallelExecution, true)
+	QA_EXECUTION_PARAMETER(qint64, CostHint, -1)
+	QA_EXECUTION_PARAMETER(qint64, TaskGranularity, 0)
 	
 	Q_PROPERTY(bool finished READ isFinished NOTIFY justStarted)
 	Q_PROPERTY(bool started READ isStarted NOTIFY justFinished)
@@ -108,35 +141,47 @@ class QAlgorithm : public QObject, public QRunnable
 	Q_PROPERTY(QACompletionMap descendants READ getDescendants)
 	
 	/** 
-	 * \brief Map with ancestors and their completion.
+	 * \brief List of ancestors.
 	 *
-	 * Map that contains information about the ancestors of the algorithm;
-	 * each key is a shared pointer to an ancestor of this algorithm,
-	 * the values are booleans stating whether the algorithm is finished or not.
+	 * Contiguous list of shared pointers to the ancestors of this algorithm,
+	 * in the order the connections have been set. The completion of each
+	 * ancestor is not stored here, see \link pendingInputs\endlink.
 	 *
 	 * \note This is a read-only property. You can have access to this property
-	 *		value through the const getter getAncestors().
+	 *		value through the const getters getAncestorList() and getAncestors().
 	 *
 	 * You can set ancestors through the functions mentioned in the see-also section.
 	 *
 	 * \sa setConnection, closeConnection, operator<<, operator>>
 	 */
-	QACompletionMap ancestors;
+	QAAdjacencyList ancestors;
 	
 	/** 
-	 * \brief Map with descendants and their completion.
+	 * \brief List of descendants.
 	 *
-	 * Map that contains information about the descendants of the algorithm;
-	 * see \link ancestors\endlink for a description of the mapped values.
+	 * Contiguous list of shared pointers to the descendants of this algorithm;
+	 * see \link ancestors\endlink for further details.
 	 *
 	 * \note This is a read-only property. You can have access to this property
-	 *		value through the const getter getDescendants().
+	 *		value through the const getters getDescendantList() and getDescendants().
 	 *
 	 * You can set descendants through the functions mentioned in the see-also section.
 	 *
 	 * \sa setConnection, closeConnection, operator<<, operator>>
 	 */
-	QACompletionMap descendants;
+	QAAdjacencyList descendants;
+	
+	/** 
+	 * \brief Number of ancestors that have not delivered their outputs yet.
+	 *
+	 * The counter is incremented by setConnection() for each ancestor not yet
+	 * finished, and decremented as soon as an ancestor propagates its outputs,
+	 * either by propagateExecution() or by a QAGraphExecutor. It can be safely
+	 * read and written from different threads.
+	 *
+	 * \sa allInputsReady
+	 */
+	QAtomicInt pendingInputs;
 	
 	/** 
 	 * \brief Whether the algorithm finished to run and outputs are ready.
@@ -149,7 +194,7 @@ class QAlgorithm : public QObject, public QRunnable
 	 *
 	 * \sa setFinished, isFinished, started
 	 */
-	bool finished = false;
+	QAtomicInt finished;
 	
 	/** 
 	 * \brief Set the algorithm as comleted and signals it.
@@ -176,7 +221,7 @@ class QAlgorithm : public QObject, public QRunnable
 	 *
 	 * \sa setStarted, isStarted, finished
 	 */
-	bool started = false;
+	QAtomicInt started;
 	
 	/** 
 	 * \brief Set the algorithm as started and signals it.
@@ -192,10 +237,178 @@ class QAlgorithm : public QObject, public QRunnable
 	 */
 	void setStarted();
 	
+	/**
+	 * \brief Whether the execution is driven by a QAGraphExecutor.
+	 *
+	 * When set, propagateExecution() does nothing, since the executor itself
+	 * transfers outputs and starts descendants.
+	 */
+	bool managed = false;
+	
+	/**
+	 * \brief Invalidate every input property.
+	 *
+	 * Each input property is reset, see resetInputs(), or set to a null
+	 * QVariant if it has no reset function; this is useful
+	 * if the input has been received with implicit sharing.
+	 */
+	void releaseInputs();
+	
+	/**
+	 * \brief Reset every resettable input property.
+	 *
+	 * Calls the reset function of each input and input port property, as
+	 * generated by QA_INPUT(), QA_INPUT_LIST(), QA_INPUT_VEC() and QA_INPUT_PORT().
+	 *
+	 * \return Whether every input property has been reset.
+	 */
+	bool resetInputs();
+	
+	/**
+	 * \brief Clear the completion state of this algorithm only.
+	 *
+	 * Clears \link started\endlink and \link finished\endlink, resets
+	 * the inputs and makes the algorithm wait again for every ancestor.
+	 *
+	 * \sa rearm
+	 */
+	void rearmNode();
+	
+	/**
+	 * \brief Count how many consumers each property has.
+	 *
+	 * The counters are stored in consumerCounts, until clearConsumers() is called.
+	 *
+	 * \param[in] consumers The algorithms that will receive this algorithm's properties.
+	 * \param[out] plans The binding plan towards each consumer, in the same order.
+	 */
+	void countConsumers(const QAAdjacencyList& consumers, QVector<QABindingPlan>& plans);
+	
+	/**
+	 * \brief Reset the outputs whose last consumer has been served.
+	 *
+	 * Decrements the counters of the properties bound by \e plan, and
+	 * resets each output property whose counter reaches zero. This only
+	 * spares a detach to the last consumer of implicitly shared types.
+	 *
+	 * \param[in] plan The binding plan towards the consumer just served.
+	 */
+	void releaseConsumedOutputs(const QABindingPlan& plan);
+	
+	/** \brief Forget the counters computed by countConsumers(). */
+	void clearConsumers();
+	
+	/**
+	 * \brief Number of consumers still to be served for each property.
+	 *
+	 * Indexed as in the meta-object; empty when the outputs must be kept.
+	 *
+	 * \sa isLastConsumer
+	 */
+	QVector<int> consumerCounts;
+	
+	/** \brief Thread pool running this algorithm, or a null pointer for the global one. */
+	QThreadPool* threadPool = Q_NULLPTR;
+	
+	/** \brief Profiler recording this algorithm's timings, if any. */
+	QAProfiler* profiler = Q_NULLPTR;
+	
+	/** \brief Cache of the results of this algorithm, if any. */
+	QAResultCache* resultCache = Q_NULLPTR;
+	
+	/** \brief When this algorithm has been queued for execution, or -1. */
+	qint64 enqueuedAt = -1;
+	
+	/**
+	 * \brief Average duration of run() in nanoseconds, or -1 if never measured.
+	 *
+	 * Written by the thread running the algorithm, read by the schedulers.
+	 */
+	QAtomicInteger<qint64> measuredCost = -1;
+	
+	/**
+	 * \brief Run the algorithm in the calling thread.
+	 *
+	 * Unlike serialExecution(), the \e ParallelExecution policy is left
+	 * untouched, and the ancestors are assumed to be finished. As in
+	 * parallelExecution(), setFinished() is queued to the thread this
+	 * instance lives in, where the propagation to descendants takes place.
+	 */
+	void runInline();
+	
+	/**
+	 * \brief Start the given descendants, packing them into tasks.
+	 *
+	 * Descendants are assigned to the same task as long as the sum of their
+	 * costs does not exceed \e TaskGranularity; descendants of unknown cost
+	 * get a task on their own.
+	 *
+	 * \param[in] ready Descendants whose inputs are all ready, already marked as started.
+	 */
+	void startBatches(const QAAdjacencyList& ready) const;
+	
+	/**
+	 * \brief Call run(), recording its duration if a profiler is attached.
+	 *
+	 * The duration is also measured if no \e CostHint is given, see getCost().
+	 *
+	 * \sa setProfiler
+	 */
+	void perform();
+	
+	/**
+	 * \brief Call getInput(), recording its duration if a profiler is attached.
+	 *
+	 * \sa setProfiler
+	 */
+	bool fetchInput(const QAShrAlgorithm& parent);
+	
+	/**
+	 * \brief Typed connections towards this algorithm's input ports.
+	 *
+	 * \sa setConnection(QSharedPointer<A>, QAOutPort<T> A::*, QSharedPointer<D>, QAPort<T> D::*)
+	 */
+	QVector<QAPortLink> portLinks;
+	
+	/**
+	 * \brief Output ports of this algorithm, cleared by recycle().
+	 *
+	 * Move-only ports have no property, hence they are recorded here on construction.
+	 */
+	QVector<QAOutPortBase*> outputPorts;
+	
+	/**
+	 * \brief Weak reference to the shared pointer that owns this instance.
+	 *
+	 * \sa setSharedThis, findSharedThis
+	 */
+	QWeakPointer<QAlgorithm> self;
+	
 	static quint32 print_counter;
 	
-	QFuture<void> result;
-	QFutureWatcher<void> watcher;
+	/**
+	 * \brief Forget every connection with other algorithms, on this side only.
+	 *
+	 * Unlike closeConnection(), the connected algorithms are left untouched;
+	 * this is only meant for algorithms that are discarded together.
+	 */
+	void dropConnections();
+	
+	/**
+	 * \brief Clean up the instance before it is reused by a QANodePool.
+	 *
+	 * Drops the connections, disconnects every signal, resets inputs,
+	 * outputs and output ports, and forgets any execution state.
+	 */
+	void recycle();
+	
+	friend class QAGraphExecutor;
+	friend class QAPipeline;
+	friend class QANodePool;
+	friend class QAOutPortBase;
+	friend class QANodeArena;
+	friend class QACheckpoint;
+	friend class QAMappedStore;
 	
 protected:
 	
@@ -292,19 +505,85 @@ protected:
 	/** 
 	 * \brief Find a shared pointer to this instance.
 	 *
-	 * Scans the descendants and ancestors of this algorithm looking
-	 * for a shared pointer to this instance. The first pointer found
-	 * is returned, if any, otherwise a null shared pointer is returned.
+	 * Returns the shared pointer registered with setSharedThis(), which
+	 * is done by the \e create() function, in constant time. For instances
+	 * not allocated with \e create(), scans the descendants and ancestors of
+	 * this algorithm looking for a shared pointer to this instance. The first
+	 * pointer found is returned, if any, otherwise a null shared pointer is returned.
 	 *
-	 * No shared pointer is created by this function.
+	 * No new shared pointer is created by this function, i.e. the returned
+	 * pointer shares the reference count of the owning one.
 	 *
 	 * \return Shared pointer to this instance, if any, or a null shared
 	 * pointer otherwise.
 	 *
-	 * \sa findAncestor, findDescendant
+	 * \sa findAncestor, findDescendant, setSharedThis
 	 */
 	QAShrAlgorithm findSharedThis() const;
 	
+	/**
+	 * \brief Register the shared pointer that owns this instance.
+	 *
+	 * Only a weak reference is kept, so that findSharedThis() can recover
+	 * the owning pointer without scanning the connections.
+	 *
+	 * \note This is automatically called by the \e create() function; if you
+	 * want to manually allocate a subclass instance, you should call this
+	 * function by yourself, right after wrapping the instance in a QSharedPointer.
+	 *
+	 * \param[in] ptr The shared pointer owning this instance.
+	 *
+	 * \sa findSharedThis, QA_IMPL_CREATE
+	 */
+	void setSharedThis(const QAShrAlgorithm& ptr);
+	
+	/**
+	 * \brief Transfer every bound property to a descendant, in a single pass.
+	 *
+	 * This function is called by the default implementation of getInput(),
+	 * on the parent, with the binding plan already resolved. When \e child
+	 * is the last consumer of an output, the output is released by this
+	 * instance before it is written to \e child; for implicitly shared types,
+	 * \e child thus becomes the only owner of the payload and will not need
+	 * to detach it. Any other type is deep-copied by the transfer through
+	 * QVariant, regardless of the consumer.
+	 *
+	 * Subclasses that know the type of their descendants can reimplement this
+	 * function to transfer their data directly, without going through QVariant;
+	 * isLastConsumer() tells which outputs can be moved away. Otherwise, typed
+	 * ports (see QA_OUTPUT_PORT()) move non-shared payloads to their last consumer.
+	 *
+	 * \code
+	 * bool Producer::sendOutputs(QAlgorithm* child, const QABindingPlan& plan)
+	 * {
+	 * 	Consumer* consumer = qobject_cast<Consumer*>(child);
+	 * 	if(consumer == Q_NULLPTR) return QAlgorithm::sendOutputs(child, plan);
+	 * 	const int index = metaObject()->indexOfProperty(QA_OUT "Image");
+	 * 	if(isLastConsumer(index)) consumer->setInImage(std::move(getOutRefImage()));
+	 * 	else consumer->setInImage(getOutImage());
+	 * 	return true;
+	 * }
+	 * \endcode
+	 *
+	 * \param[in] child The descendant to be served.
+	 * \param[in] plan The bindings from this instance's properties to the child's ones.
+	 * \return Whether every property has been transferred successfully.
+	 *
+	 * \sa getInput, QABindingPlan
+	 */
+	virtual bool sendOutputs(QAlgorithm* child, const QABindingPlan& plan);
+	
+	/**
+	 * \brief Whether the descendant being served is the last consumer of a property.
+	 *
+	 * Always false if KeepOutput is set, or out of the propagation of the outputs.
+	 *
+	 * \param[in] property Index of the property in the meta-object.
+	 *
+	 * \sa sendOutputs
+	 */
+	bool isLastConsumer(int property) const;
+	
 public:
 	/**
 	 * \brief Constructor.
@@ -322,28 +601,127 @@ public:
 	virtual void run() = 0;
 	
 	/** 
-	 * \brief Get the value of ancestors.
+	 * \brief Get the ancestors and their completion.
+	 *
+	 * The map is built on each call, with a key for each of the
+	 * \link ancestors\endlink, mapped to whether that ancestor is finished.
+	 * Prefer getAncestorList() when the completion is not needed.
 	 *
-	 * \return The value of this algorithm's \link ancestors\endlink.
+	 * \return A map from this algorithm's ancestors to their completion.
 	 *
-	 * \sa ancestors, descendants
+	 * \sa ancestors, descendants, getAncestorList
 	 */
 	QACompletionMap getAncestors() const;
 	
 	/** 
-	 * \brief Get the value of descendants.
+	 * \brief Get the descendants and their completion.
 	 *
-	 * \return The value of this algorithm's \link descendants\endlink.
+	 * See getAncestors() for further details.
 	 *
-	 * \sa ancestors, descendants
+	 * \return A map from this algorithm's descendants to their completion.
+	 *
+	 * \sa ancestors, descendants, getDescendantList
 	 */
 	QACompletionMap getDescendants() const;
 	
+	/**
+	 * \brief Make the algorithm graph ready to run again.
+	 *
+	 * Clears the completion state of every algorithm in the graph this
+	 * instance belongs to, so that the graph can be executed again with
+	 * serialExecution(), parallelExecution() or a QAGraphExecutor, without
+	 * creating and connecting the algorithms again. Connections, parameters
+	 * and outputs are kept, while the inputs are reset to their default value
+	 * (input lists and vectors are emptied), so that the ancestors can deliver
+	 * new ones.
+	 *
+	 * No algorithm of the graph must be running when this function is called.
+	 * Moreover, since propagateExecution() closes the connections of the
+	 * algorithms whose \e KeepInput parameter is false, graphs meant to be run
+	 * multiple times should set \e KeepInput to true, or be executed by a
+	 * QAGraphExecutor, that never closes connections.
+	 *
+	 * \note Only input properties with a RESET function can be reset; the
+	 * macros QA_INPUT(), QA_INPUT_LIST(), QA_INPUT_VEC() and QA_INPUT_PORT()
+	 * provide it.
+	 *
+	 * \code
+	 * for(const auto& item: stream)
+	 * {
+	 * 	source->setInItem(item);
+	 * 	closer->serialExecution();
+	 * 	consume(closer->getOutResult());
+	 * 	closer->rearm();
+	 * }
+	 * \endcode
+	 *
+	 * \return Whether the graph has been rearmed, i.e. no algorithm was running.
+	 *
+	 * \sa QAGraphExecutor::rearm
+	 */
+	bool rearm();
+	
+	/**
+	 * \brief Mark this algorithm and its descendants to be run again.
+	 *
+	 * Once a graph has run, changing a parameter of one of its algorithms
+	 * invalidates only the outputs of that algorithm and of its transitive
+	 * descendants. This function rearms just that subgraph, so that the next
+	 * serialExecution(), parallelExecution() or QAGraphExecutor::execute() runs
+	 * the dirty algorithms only, while the clean ancestors are not run again:
+	 * their outputs are delivered to the dirty algorithms right away.
+	 *
+	 * The setters generated by QA_PARAMETER() call this function, as well as
+	 * setParameters() and setParameter(); it does nothing if the algorithm
+	 * has not finished running, i.e. it is already dirty or has never run.
+	 *
+	 * The outputs of a clean ancestor can be reused only if they have been
+	 * kept: an ancestor whose \e KeepOutput parameter is false, or that feeds
+	 * a move-only port, is marked dirty too, together with its descendants.
+	 * The inputs of the dirty algorithms having ancestors are reset and
+	 * delivered again, hence an input assigned by hand is kept only on
+	 * algorithms without ancestors (that should set \e KeepInput to true).
+	 *
+	 * No algorithm of the subgraph must be running when this function is
+	 * called; as for rearm(), graphs meant to be run multiple times without
+	 * a QAGraphExecutor should set \e KeepInput to true, since
+	 * propagateExecution() closes the connections otherwise.
+	 *
+	 * \code
+	 * closer->serialExecution();
+	 * percentile->setOrder(0.9); // percentile and its descendants are dirty
+	 * closer->serialExecution(); // only they run again
+	 * \endcode
+	 *
+	 * \return Whether the subgraph has been marked, i.e. no algorithm was running.
+	 *
+	 * \sa rearm, QA_PARAMETER, QAResultCache
+	 */
+	bool markDirty();
+	
+	/** 
+	 * \brief Get the list of ancestors.
+	 *
+	 * \return A const reference to this algorithm's \link ancestors\endlink.
+	 *
+	 * \sa ancestors, getAncestors
+	 */
+	const QAAdjacencyList& getAncestorList() const;
+	
+	/** 
+	 * \brief Get the list of descendants.
+	 *
+	 * \return A const reference to this algorithm's \link descendants\endlink.
+	 *
+	 * \sa descendants, getDescendants
+	 */
+	const QAAdjacencyList& getDescendantList() const;
+	
 	/**
 	 * \brief Checks if the algorithm is ready to run.
 	 * 
-	 * This function scan the \link ancestors\endlink and returns 
-	 * whether they all have finished their computations.
+	 * This function reads the \link pendingInputs\endlink counter and returns 
+	 * whether every ancestor has delivered its outputs.
 	 * 
 	 * \return Whether every ancestor finished running.
 	 */
@@ -378,12 +756,106 @@ public:
 	 * only if the <em>parent</em>'s parameter name is explicitly mentioned
 	 * among the PropagationRules.
 	 *
+	 * \note The property bindings are resolved once per (parent class, child class,
+	 * PropagationRules) and cached, see QABindingPlan; then they are transferred
+	 * all together by the <em>parent</em>'s sendOutputs().
+	 *
 	 * \return Whether inputs have been loaded successfully.
 	 *
-	 * \sa makePropagationRules
+	 * \sa makePropagationRules, QABindingPlan, sendOutputs
 	 */
 	virtual bool getInput(QAShrAlgorithm parent);
 	
+	/**
+	 * \brief Attach a profiler to this algorithm.
+	 *
+	 * The profiler records the timings of run(), getInput() and
+	 * propagateExecution() for this algorithm; the profiler is not owned
+	 * and must outlive the execution. Use QAProfiler::attach() to attach
+	 * a profiler to a whole graph.
+	 *
+	 * \param[in] profiler The profiler, or a null pointer to stop profiling.
+	 *
+	 * \sa QAProfiler
+	 */
+	void setProfiler(QAProfiler* profiler);
+	
+	/**
+	 * \brief Attach a result cache to this algorithm.
+	 *
+	 * Before each run(), the cache is looked up with the current parameters
+	 * and inputs: if a result is found, run() is skipped and the outputs are
+	 * restored; otherwise the outputs are stored after run(). The cache is not
+	 * owned and must outlive the execution. Use QAResultCache::attach() to
+	 * attach a cache to a whole graph.
+	 *
+	 * \note Every value received by input lists and vectors is part of the
+	 * key, in the order of arrival; with parallel execution, the ancestors of
+	 * a fan-in may deliver in a different order each time, lowering the hit rate.
+	 *
+	 * \param[in] cache The cache, or a null pointer to stop caching.
+	 *
+	 * \sa QAResultCache
+	 */
+	void setResultCache(QAResultCache* cache);
+	
+	/**
+	 * \brief Get the attached result cache.
+	 *
+	 * \return The cache attached to this algorithm, if any, or a null pointer.
+	 */
+	QAResultCache* getResultCache() const;
+	
+	/**
+	 * \brief Set the thread pool that runs this algorithm.
+	 *
+	 * By default parallelExecution() runs algorithms on the global QThreadPool;
+	 * a graph, or part of it, can be isolated from the others by giving it a
+	 * pool of its own, possibly a QAThreadPool to set the priority and CPU
+	 * affinity of its threads. The pool is not owned and must outlive the execution.
+	 *
+	 * \param[in] pool The thread pool, or a null pointer to use the global one.
+	 *
+	 * \sa setSubtreeThreadPool, QAThreadPool, QAGraphExecutor::setThreadPool
+	 */
+	void setThreadPool(QThreadPool* pool);
+	
+	/**
+	 * \brief Set the thread pool of this algorithm and of all its descendants, recursively.
+	 *
+	 * \param[in] pool The thread pool, or a null pointer to use the global one.
+	 *
+	 * \sa setThreadPool
+	 */
+	void setSubtreeThreadPool(QThreadPool* pool);
+	
+	/**
+	 * \brief Get the thread pool that runs this algorithm.
+	 *
+	 * \return The pool given to setThreadPool(), or the global QThreadPool.
+	 */
+	QThreadPool* getThreadPool() const;
+	
+	/**
+	 * \brief Get the cost of the algorithm.
+	 *
+	 * The cost is the value of the \e CostHint parameter, if given (i.e. not
+	 * negative), otherwise the duration of run() measured on the previous
+	 * executions, smoothed with an exponential moving average.
+	 *
+	 * \return The cost in nanoseconds, or -1 if it is not known yet.
+	 *
+	 * \sa improveTree
+	 */
+	qint64 getCost() const;
+	
+	/**
+	 * \brief Get the attached profiler.
+	 *
+	 * \return The profiler attached to this algorithm, if any, or a null pointer.
+	 */
+	QAProfiler* getProfiler() const;
+	
 	/**
 	 * \brief Set parameters for the algorithm.
 	 *
@@ -394,12 +866,40 @@ public:
 	 * after calling \e setup() but before \e init(); if you want to manually allocate
 	 * a subclass instance, you should call this function by yourself.
 	 *
+	 * \note The names are looked up in a per-class index, see QAPropertyIndex.
+	 *
+	 * \note If the algorithm has already run and a parameter is set, it is marked
+	 * dirty, see markDirty(); inputs and execution parameters do not mark it.
+	 *
 	 * \param[in] parameters Name-value parameter/input pairs.
 	 *
-	 * \sa setup, init, QA_IMPL_CREATE
+	 * \sa setup, init, QA_IMPL_CREATE, setParameter
 	 */
 	virtual void setParameters(const QAPropertyMap& parameters);
 	
+	/**
+	 * \brief Resolve a parameter or input name once, for repeated assignments.
+	 *
+	 * \param[in] name Base name of the parameter or input.
+	 * \return A handle for setParameter(), that is invalid if no property matches.
+	 *
+	 * \sa setParameter, QAParameterHandle
+	 */
+	QAParameterHandle parameterHandle(const QString& name) const;
+	
+	/**
+	 * \brief Assign a value through a pre-resolved handle.
+	 *
+	 * Same as setParameters() with a single pair, without looking up the name.
+	 *
+	 * \param[in] handle A handle obtained from an instance of the same class.
+	 * \param[in] value The value to be assigned.
+	 * \return Whether the value has been assigned successfully.
+	 *
+	 * \sa parameterHandle, setParameters
+	 */
+	bool setParameter(const QAParameterHandle& handle, const QVariant& value);
+	
 	/**
 	 * \brief Create a GraphViz diagram of the algorithm tree.
 	 * 
@@ -435,16 +935,31 @@ public:
 	 * tree to generate such representation.
 	 * 
 	 * When flattenTree() is called with a flat representation \e tree as argument, then
-	 * it appends the new representation to the given one. This behaviour is internally used
-	 * by the flattenTree() method and is probably of no use for the common user.
+	 * it appends the new representation to the given one.
+	 * 
+	 * \note The representation is built from snapshot(), that should be preferred
+	 * whenever the map is not strictly needed.
 	 * 
 	 * \param[in] tree Optional representation to include in the output.
 	 * \return The flat representation of the algorithm tree structure.
 	 * 
-	 * \sa printTree, printGraph, improveTree
+	 * \sa snapshot, printTree, printGraph, improveTree
 	 */
 	QAFlatRepresentation flattenTree(QAFlatRepresentation tree = QAFlatRepresentation()) const;
 	
+	/**
+	 * \brief Takes an index-based snapshot of the algorithm graph.
+	 * 
+	 * The snapshot contains every algorithm connected to this one, that
+	 * gets index 0, and is taken in linear time without recursion.
+	 * 
+	 * \return The snapshot of the graph, or an empty snapshot if no
+	 * shared pointer to this instance can be found.
+	 * 
+	 * \sa QAGraphSnapshot, flattenTree
+	 */
+	QAGraphSnapshot snapshot() const;
+	
 	/**
 	 * \brief Outputs a text representation of the algorithm tree.
 	 * 
@@ -473,10 +988,59 @@ public:
 	 */
 	static void setConnection(QAShrAlgorithm ancestor, QAShrAlgorithm descendant);
 	
+	/**
+	 * \brief Connect an output port of an algorithm to an input port of another one.
+	 * 
+	 * The two algorithms are connected as in setConnection(QAShrAlgorithm, QAShrAlgorithm),
+	 * if they were not already. Moreover, whenever \e ancestor delivers its outputs
+	 * to \e descendant, the value of \e output is directly assigned to \e input,
+	 * without going through QVariant; the value is moved instead of copied if
+	 * \e descendant is the last consumer of \e output and \e KeepOutput is false.
+	 * The types of the ports are checked at compile time.
+	 *
+	 * Move-only values, see QA_OUTPUT_MOVE_PORT(), are always moved to the
+	 * last consumer, and cannot be delivered to the others: such an output
+	 * port should be connected to a single input port.
+	 * 
+	 * \code
+	 * QAlgorithm::setConnection(generator, &RandomGenerator::portout_Numbers,
+	 *                           average, &MovingAverage::portin_Array);
+	 * \endcode
+	 * 
+	 * \param[in] ancestor Shared pointer to the algorithm owning \e output.
+	 * \param[in] output Pointer to the output port member, see QA_OUTPUT_PORT().
+	 * \param[in] descendant Shared pointer to the algorithm owning \e input.
+	 * \param[in] input Pointer to the input port member, see QA_INPUT_PORT().
+	 * \sa closeConnection, QAPort, QAOutPort
+	 */
+	template<class A, class D, typename T>
+	static void setConnection(QSharedPointer<A> ancestor, QAOutPort<T> A::* output,
+							  QSharedPointer<D> descendant, QAPort<T> D::* input)
+	{
+		QAlgorithm::setConnection(ancestor.template staticCast<QAlgorithm>(), descendant.template staticCast<QAlgorithm>());
+		QAOutPort<T>* out = &(ancestor.data()->*output);
+		QAPort<T>* in = &(descendant.data()->*input);
+		out->m_consumers.ref();
+		if(!std::is_copy_constructible<T>::value && out->consumerCount() > 1)
+		{
+			qWarning() << "setConnection(): a move-only output port of" << ancestor->printName() << "is connected to more than one input port";
+		}
+		QAPortLink link;
+		link.source = ancestor.data();
+		link.output = out;
+		link.moveOnly = !std::is_copy_constructible<T>::value;
+		link.transfer = [out, in](bool release)
+		{
+			QAPortLink::assign(out, in, release, std::is_copy_constructible<T>());
+		};
+		static_cast<QAlgorithm*>(descendant.data())->portLinks.append(link);
+	}
+	
 	/**
 	 * \brief Disconnect two algorithms.
 	 * 
-	 * This function does the opposite of setConnection().
+	 * This function does the opposite of setConnection(), and also
+	 * removes any typed connection between their ports.
 	 * 
 	 * \param[in] ancestor 	Shared pointer to an algorithm, that you want to 
 	 						disconnect from its child \e descendant.
@@ -520,21 +1084,34 @@ public:
 	static bool isRemovableConnection(const QAShrAlgorithm p1, const QAShrAlgorithm p2);
 	
 	/**
-	 * \brief Replace all removable connections, thus improving the tree performance.
+	 * \brief Coarsen the tasks of the tree, thus improving its performance.
+	 * 
+	 * Dispatching an algorithm to a thread costs more than running it, when the
+	 * algorithm is tiny; this function uses the cost of each algorithm (see getCost())
+	 * to group cheap algorithms into tasks of about \e granularity nanoseconds:
+	 * - chains of removably-connected algorithms are fused, i.e. forced to run in the
+	 * same thread, as long as the total cost of the chain does not exceed \e granularity;
+	 * a chain is split before and after any algorithm that is heavier than \e granularity,
+	 * so that heavy algorithms keep a task on their own;
+	 * - algorithms with more descendants get \e TaskGranularity set to \e granularity
+	 * when at least two of their descendants are known to be cheaper than it, so that
+	 * these descendants are packed into batches.
+	 * 
+	 * Algorithms of unknown cost are considered free when fusing chains, and heavy
+	 * when packing batches. For best results, call this function after a first run of
+	 * the tree, or after declaring the \e CostHint of each algorithm.
 	 * 
-	 * It actually force any pair of removably-connected algorithms to run in the same thread.
 	 * If KeepInput is set to false for the parent, and properties are \e moved insted of \e copied
 	 * to the child instance, the improvement is high, since there is almost no waste in memory
 	 * and time. Indeed the parent instance will be deleted as soon as it becomes useless, and its
 	 * properties are directly exploited by the child instance without deep copying them;
 	 * furthermore time consumption is limited by running on the same thread.
 	 * 
-	 * \note This function is still experimental, since it's not been much tested.
-	 * 
 	 * \param[in] leaf Pointer to an algorithm belonging to the tree to improve.
-	 * \sa isRemovableConnection
+	 * \param[in] granularity Target duration of a task, in nanoseconds.
+	 * \sa isRemovableConnection, getCost
 	 */
-	static void improveTree(QAlgorithm* leaf);
+	static void improveTree(QAlgorithm* leaf, qint64 granularity = 50000);
 	
 	/**
 	 * \brief Convenience method for writing \e PropagationRules.
@@ -590,10 +1167,9 @@ public:
 	/**
 	 * \brief Execute descendants.
 	 * 
-	 * This functions changes values to \link ancestors\endlink and
-	 * \link descendants\endlink, making connected algorithms know that
-	 * this instance finished running. Then passes outputs and parameters
-	 * to every descendant.
+	 * This functions decrements the \link pendingInputs\endlink counter of each
+	 * descendant, making connected algorithms know that this instance
+	 * finished running. Then passes outputs and parameters to every descendant.
 	 * 
 	 * If \e KeepInput parameter is set to false, the inputs are invalidated
 	 * and the connection with descendants is closed. This will deallocate
@@ -666,7 +1242,10 @@ QDebug operator<<(QDebug debug, const QAlgorithm& c);
  * 
  * The behaviour can be customized by subclasses.
  *
- * \sa operator>>(QDataStream&, QAlgorithm&)
+ * \note Property names and types are written along with each value; use
+ * QAArchive to save many algorithms or whole graphs in a compact format.
+ *
+ * \sa operator>>(QDataStream&, QAlgorithm&), QAArchive
  */
 QDataStream& operator<<(QDataStream& stream, const QAlgorithm& c);
 
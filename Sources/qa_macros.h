@@ -39,6 +39,26 @@
 #define QA_PAR "par_"
 #endif
 
+#ifndef QA_IN_LIST
+/** \brief Prefix for the read-only properties holding every value received by input lists and vectors. */
+#define QA_IN_LIST "listin_"
+#endif
+
+#ifndef QA_PORT_IN
+/** \brief Prefix for input port properties. */
+#define QA_PORT_IN "portin_"
+#endif
+
+#ifndef QA_MOVE_PORT
+/** \brief Value of the class info that marks each move-only port, see QA_INPUT_MOVE_PORT(). */
+#define QA_MOVE_PORT "moveport"
+#endif
+
+#ifndef QA_PORT_OUT
+/** \brief Prefix for output port properties. */
+#define QA_PORT_OUT "portout_"
+#endif
+
 #ifndef QA_INPUT
 /**
  * \brief Defines an input property for the algorithm.
@@ -51,10 +71,13 @@
  * MEMBER of Q_PROPERTY.\n
  * QA_INPUT generates setter and getter methods for the given property; the
  * name convention used is:
- *  - setIn\<\e Name\> for the setter
+ *  - setIn\<\e Name\> for the setter; the value is taken by value and moved into
+ *		the member, so that passing an rvalue costs no copy
  *  - getIn\<\e Name\> for the const getter
  *  - getInRef\<\e Name\> for the getter that returns a reference to the property
  *  - getInMove\<\e Name\> for the move getter, that returns an rvalue to the property
+ *  - resetIn\<\e Name\> for the reset method, that restores the default-constructed value;
+ *		it is registered as the RESET function of the property, and used by QAlgorithm::rearm()
  *
  * \param[in] Type Type of the property; must be registered in the Qt's MetaObject System.
  * \param[in] Name Name of the property.
@@ -62,12 +85,15 @@
  * \sa QA_INPUT_LIST, QA_INPUT_VEC, QA_OUTPUT, QA_PARAMETER
  */
 #define QA_INPUT(Type, Name) 															\
-Q_PROPERTY(Type algin_##Name MEMBER m_algin_##Name READ getIn##Name WRITE setIn##Name)	\
+Q_PROPERTY(Type algin_##Name MEMBER m_algin_##Name READ getIn##Name WRITE setIn##Name RESET resetIn##Name)	\
 private:																				\
 	Type m_algin_##Name;																\
 public:																					\
 	void setIn##Name (Type value){														\
-		this->m_algin_##Name = value;													\
+		this->m_algin_##Name = std::move(value);										\
+	}																					\
+	void resetIn##Name (){																\
+		this->m_algin_##Name = Type();													\
 	}																					\
 	Type getIn##Name () const{															\
 		return this->m_algin_##Name;													\
@@ -99,6 +125,12 @@ public:																					\
  *  - getIn\<\e Name\> for the const getter, that returns the list of inputs.
  *  - getInRef\<\e Name\> for the getter that returns a reference to the list of inputs.
  *  - getInMove\<\e Name\> for the move getter, that returns an rvalue to the list of inputs.
+ *  - resetIn\<\e Name\> for the reset method, that empties the list of inputs; it is
+ *		registered as the RESET function of the property, and used by QAlgorithm::rearm().
+ *
+ * The whole list is also exposed as a read-only property called
+ * \link QA_IN_LIST\endlink\<\e Name\>, so that QAResultCache hashes every
+ * value received, not only the last one.
  *
  * \param[in] Type Type of a single property of the list; must be registered in the Qt's MetaObject System.
  * \param[in] Name Name of the property list.
@@ -106,14 +138,19 @@ public:																					\
  * \sa QA_INPUT, QA_INPUT_VEC, QA_OUTPUT, QA_PARAMETER
  */
 #define QA_INPUT_LIST(Type, Name)											\
-Q_PROPERTY(Type algin_##Name MEMBER m_algin_##Name WRITE setIn##Name)		\
+Q_PROPERTY(Type algin_##Name MEMBER m_algin_##Name WRITE setIn##Name RESET resetIn##Name)	\
+Q_PROPERTY(QList<Type> listin_##Name READ getIn##Name STORED false)		\
 private:																	\
 	Type m_algin_##Name;													\
 	QList<Type> m_listin_##Name;											\
 public:																		\
 	void setIn##Name (Type value){											\
-		this->m_algin_##Name = value;										\
 		this->m_listin_##Name << value;										\
+		this->m_algin_##Name = std::move(value);							\
+	}																		\
+	void resetIn##Name (){													\
+		this->m_algin_##Name = Type();										\
+		this->m_listin_##Name.clear();										\
 	}																		\
 	QList<Type> getIn##Name () const{										\
 		return this->m_listin_##Name;										\
@@ -132,7 +169,9 @@ public:																		\
  *
  * The purpose of this macro is the same of QA_INPUT_LIST, but instead
  * of appending to a QList, uses a QVector. Its intent is to be used whenever
- * memory contiguity is of concern.
+ * memory contiguity is of concern. The reset method keeps the capacity of
+ * the vector, so that a rearmed algorithm does not reallocate it. The whole
+ * vector is exposed as the read-only property \link QA_IN_LIST\endlink\<\e Name\>.
  *
  * \param[in] Type Type of a single property of the vector; must be registered in the Qt's MetaObject System.
  * \param[in] Name Name of the property list.
@@ -140,14 +179,19 @@ public:																		\
  * \sa QA_INPUT, QA_INPUT_LIST, QA_OUTPUT, QA_PARAMETER
  */
 #define QA_INPUT_VEC(Type, Name)												\
-Q_PROPERTY(Type algin_##Name MEMBER m_algin_##Name WRITE setIn##Name)			\
+Q_PROPERTY(Type algin_##Name MEMBER m_algin_##Name WRITE setIn##Name RESET resetIn##Name)	\
+Q_PROPERTY(QVector<Type> listin_##Name READ getIn##Name STORED false)		\
 private:																		\
 	Type m_algin_##Name;														\
 	QVector<Type> m_vecin_##Name;												\
 public:																			\
 	void setIn##Name (Type value){												\
-		this->m_algin_##Name = value;											\
 		this->m_vecin_##Name << value;											\
+		this->m_algin_##Name = std::move(value);								\
+	}																			\
+	void resetIn##Name (){														\
+		this->m_algin_##Name = Type();											\
+		this->m_vecin_##Name.resize(0);											\
 	}																			\
 	QVector<Type> getIn##Name () const{											\
 		return this->m_vecin_##Name;											\
@@ -171,6 +215,11 @@ public:																			\
  * MEMBER of Q_PROPERTY.\n
  * QA_OUTPUT generates setter and getter methods for the given property; the
  * name convention used is the same as in QA_INPUT.
+ *
+ * \note Outputs are transferred to the descendants through QVariant, which is
+ * cheap only for implicitly shared types; large payloads of other types, such as
+ * std::vector, should be sent through typed ports instead, see QA_OUTPUT_PORT(),
+ * that are moved to their last consumer.
  * 
  * \param[in] Type Type of the property; must be registered in the Qt's MetaObject System.
  * \param[in] Name Name of the property.
@@ -184,7 +233,7 @@ private:																						\
 	Type m_algout_##Name;																		\
 protected:																						\
 	void setOut##Name (Type value){																\
-		this->m_algout_##Name = value;															\
+		this->m_algout_##Name = std::move(value);												\
 	}																							\
 public:																							\
 	Type getOut##Name () const{																	\
@@ -209,14 +258,15 @@ public:																							\
  * for the subclass called \link QA_PAR\endlink\<\e Name\>.\n
  * QA_PARAMETER generates setter and getter methods for the given property; the
  * name convention used is:
- *  - setIn\<\e Name\> for the setter
- *  - getIn\<\e Name\> for the getter
+ *  - set\<\e Name\> for the setter; when the algorithm has already run, it
+ *		marks the algorithm and its descendants dirty, see QAlgorithm::markDirty()
+ *  - get\<\e Name\> for the getter
  *
  * \param[in] Type Type of the property; must be registered in the Qt's MetaObject System.
  * \param[in] Name Name of the property.
  * \param[in] Default Value of type \e Type to be used as default for the parameter.
  * 
- * \sa QA_INPUT, QA_INPUT_LIST, QA_INPUT_VEC, QA_OUTPUT
+ * \sa QA_INPUT, QA_INPUT_LIST, QA_INPUT_VEC, QA_OUTPUT, QA_EXECUTION_PARAMETER
  */
 #define QA_PARAMETER(Type, Name, Default)													\
 Q_PROPERTY(Type par_##Name READ get##Name WRITE set##Name)									\
@@ -224,13 +274,183 @@ private:																					\
 	Type par_##Name = Default;																\
 public:																						\
 	void set##Name (Type value){															\
-	this->par_##Name = value;																\
+	this->par_##Name = std::move(value);													\
+	this->markDirty();																		\
 	}																						\
-Type get##Name (){																			\
+Type get##Name () const{																	\
 	return this->par_##Name;																\
 }
 #endif
 
+#ifndef QA_EXECUTION_PARAMETER
+/**
+ * \brief Defines a parameter that affects how the algorithm is executed, not its results.
+ *
+ * Same as QA_PARAMETER(), except that the setter never marks the algorithm
+ * dirty: changing the parameter does not require to run the algorithm again.
+ * QAlgorithm uses it for \e KeepInput, \e ParallelExecution and the like.
+ *
+ * \param[in] Type Type of the property; must be registered in the Qt's MetaObject System.
+ * \param[in] Name Name of the property.
+ * \param[in] Default Value of type \e Type to be used as default for the parameter.
+ *
+ * \sa QA_PARAMETER
+ */
+#define QA_EXECUTION_PARAMETER(Type, Name, Default)											\
+Q_PROPERTY(Type par_##Name READ get##Name WRITE set##Name)									\
+private:																					\
+	Type par_##Name = Default;																\
+public:																						\
+	void set##Name (Type value){															\
+	this->par_##Name = std::move(value);													\
+	}																						\
+Type get##Name () const{																	\
+	return this->par_##Name;																\
+}
+#endif
+
+#ifndef QA_INPUT_PORT
+/**
+ * \brief Defines a typed input port for the algorithm.
+ *
+ * This macro is an alternative to QA_INPUT() for inputs that are received
+ * through typed connections, see
+ * QAlgorithm::setConnection(QSharedPointer<A>, QAOutPort<T> A::*, QSharedPointer<D>, QAPort<T> D::*).
+ * It defines a public member of type QAPort\<\e Type\> called \link QA_PORT_IN\endlink\<\e Name\>,
+ * and registers a property with the same name in the Qt's MetaObject System,
+ * so that the port is still available for scripting and serialization.
+ * Since the property name does not start with \link QA_IN\endlink, it is never
+ * involved in the QVariant-based transfer performed by QAlgorithm::getInput().
+ *
+ * The setter, getter and reset methods follow the same name convention of QA_INPUT().
+ *
+ * \param[in] Type Type of the port; must be registered in the Qt's MetaObject System.
+ * \param[in] Name Name of the port.
+ *
+ * \sa QA_OUTPUT_PORT, QA_INPUT, QAPort
+ */
+#define QA_INPUT_PORT(Type, Name)															\
+Q_PROPERTY(Type portin_##Name READ getIn##Name WRITE setIn##Name RESET resetIn##Name)		\
+public:																						\
+	QAPort<Type> portin_##Name;																\
+	void setIn##Name (Type value){															\
+		this->portin_##Name.set(std::move(value));											\
+	}																						\
+	void resetIn##Name (){																	\
+		this->portin_##Name.set(Type());													\
+	}																						\
+	Type getIn##Name () const{																\
+		return this->portin_##Name.get();													\
+	}																						\
+	Type& getInRef##Name (){																\
+		return this->portin_##Name.ref();													\
+	}																						\
+	Type&& getInMove##Name (){																\
+		return this->portin_##Name.move();													\
+	}
+#endif
+
+#ifndef QA_OUTPUT_PORT
+/**
+ * \brief Defines a typed output port for the algorithm.
+ *
+ * This macro is an alternative to QA_OUTPUT() for outputs that are sent
+ * through typed connections; it defines a public member of type
+ * QAOutPort\<\e Type\> called \link QA_PORT_OUT\endlink\<\e Name\>, and
+ * registers a property with the same name, see QA_INPUT_PORT().
+ *
+ * The setter and getter methods follow the same name convention of QA_OUTPUT().
+ *
+ * \param[in] Type Type of the port; must be registered in the Qt's MetaObject System.
+ * \param[in] Name Name of the port.
+ *
+ * \sa QA_INPUT_PORT, QA_OUTPUT, QAOutPort
+ */
+#define QA_OUTPUT_PORT(Type, Name)															\
+Q_PROPERTY(Type portout_##Name READ getOut##Name WRITE setOut##Name)						\
+public:																						\
+	QAOutPort<Type> portout_##Name{this};													\
+protected:																					\
+	void setOut##Name (Type value){															\
+		this->portout_##Name.set(std::move(value));											\
+	}																						\
+public:																						\
+	Type getOut##Name () const{																\
+		return this->portout_##Name.get();													\
+	}																						\
+	Type& getOutRef##Name (){																\
+		return this->portout_##Name.ref();													\
+	}																						\
+	Type&& getOutMove##Name (){																\
+		return this->portout_##Name.move();													\
+	}
+#endif
+
+#ifndef QA_INPUT_MOVE_PORT
+/**
+ * \brief Defines a typed input port for values that cannot be copied.
+ *
+ * Same as QA_INPUT_PORT(), for move-only types such as buffers with unique
+ * ownership. Since such values cannot be held by a QVariant, no property is
+ * registered: the port can only be reached through typed connections, and it
+ * is not reset by QAlgorithm::rearm(). The setter takes an rvalue, and there
+ * is no const getter. The port is recorded as a class info named after it,
+ * with value \link QA_MOVE_PORT\endlink, so that QAResultCache can tell
+ * that the class cannot be cached.
+ *
+ * \param[in] Type Type of the port; it must be move-constructible.
+ * \param[in] Name Name of the port.
+ *
+ * \sa QA_OUTPUT_MOVE_PORT, QA_INPUT_PORT, QAPort
+ */
+#define QA_INPUT_MOVE_PORT(Type, Name)														\
+Q_CLASSINFO(QA_PORT_IN #Name, QA_MOVE_PORT)													\
+public:																						\
+	QAPort<Type> portin_##Name;																\
+	void setIn##Name (Type&& value){														\
+		this->portin_##Name.set(std::move(value));											\
+	}																						\
+	void resetIn##Name (){																	\
+		this->portin_##Name.set(Type());													\
+	}																						\
+	Type& getInRef##Name (){																\
+		return this->portin_##Name.ref();													\
+	}																						\
+	Type&& getInMove##Name (){																\
+		return this->portin_##Name.move();													\
+	}
+#endif
+
+#ifndef QA_OUTPUT_MOVE_PORT
+/**
+ * \brief Defines a typed output port for values that cannot be copied.
+ *
+ * Same as QA_OUTPUT_PORT(), for move-only types; no property is registered,
+ * and the port is recorded as a class info, see QA_INPUT_MOVE_PORT(). The value is always moved to the last consumer,
+ * regardless of \e KeepOutput, thus the port should have a single consumer.
+ *
+ * \param[in] Type Type of the port; it must be move-constructible.
+ * \param[in] Name Name of the port.
+ *
+ * \sa QA_INPUT_MOVE_PORT, QA_OUTPUT_PORT, QAOutPort
+ */
+#define QA_OUTPUT_MOVE_PORT(Type, Name)														\
+Q_CLASSINFO(QA_PORT_OUT #Name, QA_MOVE_PORT)												\
+public:																						\
+	QAOutPort<Type> portout_##Name{this};													\
+protected:																					\
+	void setOut##Name (Type&& value){														\
+		this->portout_##Name.set(std::move(value));											\
+	}																						\
+public:																						\
+	Type& getOutRef##Name (){																\
+		return this->portout_##Name.ref();													\
+	}																						\
+	Type&& getOutMove##Name (){																\
+		return this->portout_##Name.move();													\
+	}
+#endif
+
 /** 
  * \brief Make a subclass inherit QAlgorithm's default constructor.
  * 
@@ -260,11 +480,16 @@ protected:																					\
  * 
  * The create method is a wrapper around a set of operations:
  * - algorithm allocation on the heap
+ * - registration of the weak self-reference used by QAlgorithm::findSharedThis()
  * - call to QAlgorithm::setup() (subclasses can reimplement it)
  * - if a set of parameter name-value pairs are provided, they are passed to
  *		the algorithm using QAlgorithm::setParameters()
  * - call to QAlgorithm::init() (subclasses can reimplement it)
  *
+ * It also defines a \e createPooled static method, that does the same but takes
+ * the instance from a QANodePool, if one is available, and gives it back to the
+ * pool when the last shared pointer goes away, instead of deleting it.
+ *
  * \b Note: this macro cannot be used in abstract subclass.
  *
  * @param[in] ClassName Name of the subclass which inherit from QAlgorithm.
@@ -275,6 +500,24 @@ public:																								\
 	static inline QSharedPointer<ClassName> create(QAPropertyMap parameters = QAPropertyMap(),		\
 													QObject* parent = Q_NULLPTR){					\
 		auto ptr = QSharedPointer<ClassName>(new ClassName(parent), &QObject::deleteLater);			\
+		ptr->setSharedThis(ptr);																	\
+		ptr->setup();																				\
+		if(!parameters.isEmpty()){																	\
+			ptr->setParameters(parameters);															\
+		}																							\
+		ptr->init();																				\
+		return ptr;																					\
+	}																								\
+	static inline QSharedPointer<ClassName> createPooled(QAPropertyMap parameters = QAPropertyMap(),	\
+														 QANodePool* pool = QANodePool::globalInstance()){	\
+		auto node = static_cast<ClassName*>(pool->acquire(&ClassName::staticMetaObject));			\
+		if(node == Q_NULLPTR){																		\
+			node = new ClassName();																	\
+			pool->adopt(node);																		\
+		}																							\
+		const QPointer<QANodePool> owner(pool);														\
+		auto ptr = QSharedPointer<ClassName>(node, [owner](ClassName* p){QANodePool::dispose(owner, p);});	\
+		ptr->setSharedThis(ptr);																	\
 		ptr->setup();																				\
 		if(!parameters.isEmpty()){																	\
 			ptr->setParameters(parameters);															\
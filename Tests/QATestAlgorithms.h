@@ -0,0 +1,144 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+/** \file QATestAlgorithms.h
+ *  Small algorithms shared by the unit tests.
+ */
+
+#ifndef QATestAlgorithms_h
+#define QATestAlgorithms_h
+
+#include <QtCore>
+#include <QAlgorithm.h>
+#include <QAGraphExecutor.h>
+
+/** \brief Source algorithm: outputs Base, Base+1, Base+2, Base+3 and their sum. */
+class Producer: public QAlgorithm
+{
+	Q_OBJECT
+
+	QA_PARAMETER(double, Base, 0.0)
+	QA_OUTPUT(QVector<double>, Values)
+	QA_OUTPUT(double, Value)
+
+	QA_IMPL_CREATE(Producer)
+	QA_CTOR_INHERIT
+
+public:
+	/** \brief Number of times run() has been called. */
+	QAtomicInt runs;
+
+	void run()
+	{
+		runs.ref();
+		QVector<double> values;
+		double sum = 0.0;
+		for(int k = 0; k < 4; ++k)
+		{
+			values << getBase() + k;
+			sum += values.last();
+		}
+		setOutValues(values);
+		setOutValue(sum);
+	}
+};
+
+/** \brief Multiplies its input by Factor. */
+class Scaler: public QAlgorithm
+{
+	Q_OBJECT
+
+	QA_INPUT(double, Value)
+	QA_PARAMETER(double, Factor, 1.0)
+	QA_OUTPUT(double, Value)
+
+	QA_IMPL_CREATE(Scaler)
+	QA_CTOR_INHERIT
+
+public:
+	/** \brief Number of times run() has been called. */
+	QAtomicInt runs;
+
+	void run()
+	{
+		runs.ref();
+		setOutValue(getInValue() * getFactor());
+	}
+};
+
+/** \brief Sums the values received from every ancestor. */
+class Summer: public QAlgorithm
+{
+	Q_OBJECT
+
+	QA_INPUT_LIST(double, Value)
+	QA_OUTPUT(double, Value)
+
+	QA_IMPL_CREATE(Summer)
+	QA_CTOR_INHERIT
+
+public:
+	/** \brief Number of times run() has been called. */
+	QAtomicInt runs;
+
+	void run()
+	{
+		runs.ref();
+		double sum = 0.0;
+		for(double value: getInRefValue()) sum += value;
+		setOutValue(sum);
+	}
+};
+
+/** \brief Averages the values of an array. */
+class Averager: public QAlgorithm
+{
+	Q_OBJECT
+
+	QA_INPUT(QVector<double>, Values)
+	QA_OUTPUT(double, Value)
+
+	QA_IMPL_CREATE(Averager)
+	QA_CTOR_INHERIT
+
+public:
+	/** \brief Number of times run() has been called. */
+	QAtomicInt runs;
+
+	void run()
+	{
+		runs.ref();
+		double sum = 0.0;
+		for(double value: getInRefValues()) sum += value;
+		setOutValue(getInRefValues().isEmpty() ? 0.0 : sum / getInRefValues().size());
+	}
+};
+
+namespace QATest
+{
+	/** \brief Run the graph which \e node belongs to, waiting for its end. */
+	inline bool execute(const QAShrAlgorithm& node)
+	{
+		QAGraphExecutor executor(node);
+		executor.execute();
+		return executor.waitForDone(10000);
+	}
+}
+
+#endif /* QATestAlgorithms_h */
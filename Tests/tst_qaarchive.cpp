@@ -0,0 +1,99 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include <QtTest>
+#include <QAArchive.h>
+#include "QATestAlgorithms.h"
+
+class TestArchive: public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void nodeRoundTrip();
+	void graphRoundTrip();
+	void corruptedArray();
+};
+
+void TestArchive::nodeRoundTrip()
+{
+	auto producer = Producer::create({{"Base", 2.0}});
+	producer->run();
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+	{
+		QAArchive archive(&buffer);
+		QVERIFY(archive.save(*producer));
+	}
+	buffer.seek(0);
+	auto restored = Producer::create();
+	QAArchive archive(&buffer);
+	QVERIFY(archive.load(*restored));
+	QCOMPARE(restored->getBase(), 2.0);
+	QCOMPARE(restored->getOutValues(), producer->getOutValues());
+	QCOMPARE(restored->getOutValue(), producer->getOutValue());
+}
+
+void TestArchive::graphRoundTrip()
+{
+	auto producer = Producer::create({{"Base", 1.0}});
+	auto scaler = Scaler::create({{"Factor", 3.0}});
+	producer >> scaler;
+	QVERIFY(QATest::execute(producer));
+	QCOMPARE(scaler->getOutValue(), 30.0);
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+	{
+		QAArchive archive(&buffer);
+		QVERIFY(archive.saveGraph(producer));
+	}
+	// A graph of the same shape receives the saved states
+	buffer.seek(0);
+	auto producer2 = Producer::create();
+	auto scaler2 = Scaler::create();
+	producer2 >> scaler2;
+	QAArchive archive(&buffer);
+	QVERIFY(archive.loadGraph(producer2));
+	QCOMPARE(producer2->getBase(), 1.0);
+	QCOMPARE(producer2->getOutValues(), producer->getOutValues());
+	QCOMPARE(scaler2->getFactor(), 3.0);
+	QCOMPARE(scaler2->getOutValue(), 30.0);
+}
+
+void TestArchive::corruptedArray()
+{
+	auto producer = Producer::create({{"Base", 2.0}});
+	producer->run();
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+	{
+		QAArchive archive(&buffer);
+		QVERIFY(archive.save(*producer));
+	}
+	// Drop the tail of the record: the arrays no longer fit in the data left
+	buffer.buffer().chop(16);
+	buffer.seek(0);
+	auto restored = Producer::create();
+	QAArchive archive(&buffer);
+	QVERIFY(!archive.load(*restored));
+}
+
+QTEST_GUILESS_MAIN(TestArchive)
+
+#include "tst_qaarchive.moc"
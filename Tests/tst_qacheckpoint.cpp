@@ -0,0 +1,76 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include <QtTest>
+#include <QACheckpoint.h>
+#include "QATestAlgorithms.h"
+
+class TestCheckpoint: public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void restorePartialGraph();
+	void watch();
+};
+
+void TestCheckpoint::restorePartialGraph()
+{
+	QTemporaryDir directory;
+	QVERIFY(directory.isValid());
+	QACheckpoint checkpoint(directory.path());
+	{
+		auto producer = Producer::create({{"Base", 1.0}});
+		auto scaler = Scaler::create({{"Factor", 2.0}});
+		producer >> scaler;
+		QVERIFY(QATest::execute(producer));
+		// Only the producer is left finished
+		scaler->markDirty();
+		QVERIFY(checkpoint.save(producer));
+	}
+	auto producer = Producer::create({{"Base", 1.0}});
+	auto scaler = Scaler::create({{"Factor", 2.0}});
+	producer >> scaler;
+	QVERIFY(checkpoint.restore(producer));
+	QVERIFY(producer->isFinished());
+	QVERIFY(!scaler->isFinished());
+	QVERIFY(scaler->allInputsReady());
+	QVERIFY(QATest::execute(producer));
+	QCOMPARE(producer->runs.loadAcquire(), 0);
+	QCOMPARE(scaler->runs.loadAcquire(), 1);
+	QCOMPARE(scaler->getOutValue(), 20.0);
+}
+
+void TestCheckpoint::watch()
+{
+	QTemporaryDir directory;
+	QVERIFY(directory.isValid());
+	QACheckpoint checkpoint(directory.path());
+	auto producer = Producer::create({{"Base", 1.0}});
+	auto scaler = Scaler::create();
+	producer >> scaler;
+	checkpoint.watch(producer);
+	QVERIFY(QATest::execute(producer));
+	// The save is queued to this thread
+	QTRY_VERIFY(checkpoint.exists());
+}
+
+QTEST_GUILESS_MAIN(TestCheckpoint)
+
+#include "tst_qacheckpoint.moc"
@@ -0,0 +1,89 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include <QtTest>
+#include <QAMappedStore.h>
+#include "QATestAlgorithms.h"
+
+class TestMappedStore: public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void deliverOutputs();
+	void rejectInvalidFiles();
+};
+
+void TestMappedStore::deliverOutputs()
+{
+	QTemporaryDir directory;
+	QVERIFY(directory.isValid());
+	const QString path = directory.filePath("stages.bin");
+	{
+		auto producer = Producer::create({{"Base", 1.0}});
+		auto averager = Averager::create();
+		producer >> averager;
+		QVERIFY(QATest::execute(producer));
+		QAMappedStore store(path);
+		QVERIFY(store.open(QIODevice::WriteOnly));
+		// Only the array output is stored
+		QCOMPARE(store.saveOutputs(producer), 1);
+		QVERIFY(store.close());
+	}
+	auto producer = Producer::create({{"Base", 1.0}});
+	auto averager = Averager::create();
+	producer >> averager;
+	QAMappedStore store(path);
+	QVERIFY(store.open(QIODevice::ReadOnly));
+	QCOMPARE(store.deliverOutputs(producer), 1);
+	QVERIFY(producer->isFinished());
+	QVERIFY(averager->allInputsReady());
+	QVERIFY(QATest::execute(producer));
+	QCOMPARE(producer->runs.loadAcquire(), 0);
+	QCOMPARE(averager->runs.loadAcquire(), 1);
+	QCOMPARE(averager->getOutValue(), 2.5);
+}
+
+void TestMappedStore::rejectInvalidFiles()
+{
+	QTemporaryDir directory;
+	QVERIFY(directory.isValid());
+	const QString path = directory.filePath("stages.bin");
+	{
+		QAMappedStore store(path);
+		QVERIFY(store.open(QIODevice::WriteOnly));
+		QVERIFY(store.write("samples", QVector<double>(1000, 1.0)));
+		QVERIFY(store.close());
+	}
+	// A data file truncated by a crash
+	QVERIFY(QFile::resize(path, 1024));
+	QAMappedStore truncated(path);
+	QVERIFY(!truncated.open(QIODevice::ReadOnly));
+	// A data file that was not written by a store
+	QFile file(path);
+	QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+	file.write(QByteArray(8192, 'x'));
+	file.close();
+	QAMappedStore foreign(path);
+	QVERIFY(!foreign.open(QIODevice::ReadOnly));
+}
+
+QTEST_GUILESS_MAIN(TestMappedStore)
+
+#include "tst_qamappedstore.moc"
@@ -0,0 +1,73 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include <QtTest>
+#include "QATestAlgorithms.h"
+
+class TestMarkDirty: public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void parameterRerunsSubgraph();
+	void inputsDoNotMarkDirty();
+};
+
+void TestMarkDirty::parameterRerunsSubgraph()
+{
+	auto producer = Producer::create({{"Base", 1.0}});
+	auto doubler = Scaler::create({{"Factor", 2.0}});
+	auto tripler = Scaler::create({{"Factor", 3.0}});
+	auto summer = Summer::create();
+	producer >> doubler >> summer;
+	producer >> tripler;
+	QVERIFY(QATest::execute(producer));
+	QCOMPARE(summer->getOutValue(), 20.0);
+	QCOMPARE(tripler->getOutValue(), 30.0);
+	// Only the doubler and its descendants run again
+	doubler->setFactor(4.0);
+	QVERIFY(!doubler->isFinished());
+	QVERIFY(!summer->isFinished());
+	QVERIFY(producer->isFinished());
+	QVERIFY(tripler->isFinished());
+	QVERIFY(QATest::execute(producer));
+	QCOMPARE(producer->runs.loadAcquire(), 1);
+	QCOMPARE(doubler->runs.loadAcquire(), 2);
+	QCOMPARE(summer->runs.loadAcquire(), 2);
+	QCOMPARE(tripler->runs.loadAcquire(), 1);
+	QCOMPARE(summer->getOutValue(), 40.0);
+	QCOMPARE(tripler->getOutValue(), 30.0);
+}
+
+void TestMarkDirty::inputsDoNotMarkDirty()
+{
+	auto producer = Producer::create({{"Base", 1.0}});
+	auto scaler = Scaler::create();
+	producer >> scaler;
+	QVERIFY(QATest::execute(producer));
+	scaler->setParameters({{"Value", 5.0}, {"KeepInput", true}});
+	QVERIFY(scaler->isFinished());
+	scaler->setParameters({{"Factor", 2.0}});
+	QVERIFY(!scaler->isFinished());
+	QVERIFY(producer->isFinished());
+}
+
+QTEST_GUILESS_MAIN(TestMarkDirty)
+
+#include "tst_qamarkdirty.moc"
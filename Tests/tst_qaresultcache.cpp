@@ -0,0 +1,101 @@
+// QAlgorithm: a class for Qt/C++ implementing generic algorithm logic.
+// Copyright (C) 2018  Filippo Santarelli
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Contact me at: filippo2.santarelli@gmail.com
+//
+
+#include <QtTest>
+#include <QAResultCache.h>
+#include "QATestAlgorithms.h"
+
+class TestResultCache: public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void hitsAndMisses();
+	void inputLists();
+	void diskTier();
+};
+
+void TestResultCache::hitsAndMisses()
+{
+	QAResultCache cache(10);
+	auto first = Scaler::create({{"Factor", 2.0}, {"Value", 3.0}});
+	first->setResultCache(&cache);
+	first->serialExecution();
+	QCOMPARE(first->runs.loadAcquire(), 1);
+	QCOMPARE(cache.misses(), qint64(1));
+	// Same parameters and inputs: the result is restored
+	auto second = Scaler::create({{"Factor", 2.0}, {"Value", 3.0}});
+	second->setResultCache(&cache);
+	second->serialExecution();
+	QCOMPARE(second->runs.loadAcquire(), 0);
+	QCOMPARE(second->getOutValue(), 6.0);
+	QCOMPARE(cache.hits(), qint64(1));
+	// Another parameter: the algorithm runs
+	auto third = Scaler::create({{"Factor", 4.0}, {"Value", 3.0}});
+	third->setResultCache(&cache);
+	third->serialExecution();
+	QCOMPARE(third->runs.loadAcquire(), 1);
+	QCOMPARE(third->getOutValue(), 12.0);
+	QCOMPARE(cache.misses(), qint64(2));
+}
+
+void TestResultCache::inputLists()
+{
+	QAResultCache cache(10);
+	auto first = Summer::create();
+	first->setInValue(1.0);
+	first->setInValue(2.0);
+	first->setResultCache(&cache);
+	first->serialExecution();
+	QCOMPARE(first->getOutValue(), 3.0);
+	// Same last value, different earlier one: not the same key
+	auto second = Summer::create();
+	second->setInValue(5.0);
+	second->setInValue(2.0);
+	second->setResultCache(&cache);
+	second->serialExecution();
+	QCOMPARE(second->runs.loadAcquire(), 1);
+	QCOMPARE(second->getOutValue(), 7.0);
+	QCOMPARE(cache.hits(), qint64(0));
+}
+
+void TestResultCache::diskTier()
+{
+	QTemporaryDir directory;
+	QVERIFY(directory.isValid());
+	{
+		QAResultCache cache(10);
+		cache.setDirectory(directory.path());
+		auto scaler = Scaler::create({{"Factor", 2.0}, {"Value", 3.0}});
+		scaler->setResultCache(&cache);
+		scaler->serialExecution();
+	}
+	// A new cache finds the result on disk
+	QAResultCache cache(10);
+	cache.setDirectory(directory.path());
+	auto scaler = Scaler::create({{"Factor", 2.0}, {"Value", 3.0}});
+	scaler->setResultCache(&cache);
+	scaler->serialExecution();
+	QCOMPARE(scaler->runs.loadAcquire(), 0);
+	QCOMPARE(scaler->getOutValue(), 6.0);
+}
+
+QTEST_GUILESS_MAIN(TestResultCache)
+
+#include "tst_qaresultcache.moc"